@@ -0,0 +1,368 @@
+//
+// Created by craig on 17/10/2026.
+//
+// Microbenchmarks for the per-IO conversion paths: the wvalue conversion
+// GET /api/nodes used before NodeJsonWriter (kept here as the baseline),
+// NodeJsonWriter, NodeBinaryWriter, and
+// EngineService::setFlexValue. Each runs over synthetic GetAllValuesResults
+// of 10 to 1000 nodes with 8 inputs and 8 outputs, and reports time and heap
+// allocations per IO; the document writers also report encoded bytes per IO.
+//
+// The write-route body benchmarks compare crow::json::load plus field
+// extraction with JsonBodyParser, each filling a Cap'n Proto builder from
+// one request body, and report allocations per body.
+
+#include <benchmark/benchmark.h>
+#include <capnp/message.h>
+#include <atomic>
+#include <cstdlib>
+#include <new>
+#include "crow.h"
+#include "../engine_service.hpp"
+#include "../json_body_parser.hpp"
+#include "../node_binary_writer.hpp"
+#include "../node_json_writer.hpp"
+
+namespace {
+
+std::atomic<uint64_t> allocations{0};
+
+constexpr uint32_t IOS_PER_NODE = 8;
+
+// Builds nodes whose IO values cycle through every FlexValueCap kind.
+void fillMessage(capnp::MallocMessageBuilder& message, uint32_t nodeCount) {
+  auto nodes = message.initRoot<Engine::GetAllValuesResults>().initNodes(nodeCount);
+  uint32_t n = 0;
+  auto fillValue = [&n](FlexValueCap::Builder value) {
+    switch (n++ % 5) {
+      case 0: value.setIntVal(-static_cast<int32_t>(n)); break;
+      case 1: value.setUintVal(n); break;
+      case 2: value.setBoolVal(n % 2 == 0); break;
+      case 3: value.setDoubleVal(n * 0.1); break;
+      default: value.setStringVal(kj::str("value-", n)); break;
+    }
+  };
+  auto fillIOs = [&fillValue](capnp::List<IO, capnp::Kind::STRUCT>::Builder ios, const char* prefix) {
+    for (uint32_t i = 0; i < ios.size(); i++) {
+      ios[i].setName(kj::str(prefix, i));
+      fillValue(ios[i].getValue());
+      ios[i].setOverride(i % 3 == 0);
+      fillValue(ios[i].getOverrideValue());
+      fillValue(ios[i].getDefaultValue());
+    }
+  };
+
+  for (uint32_t i = 0; i < nodeCount; i++) {
+    nodes[i].setInstanceId(i + 1);
+    nodes[i].setNodeName(kj::str("node", i));
+    auto status = nodes[i].initNodeStatus();
+    status.setStatus("ok");
+    status.setCount(i);
+    status.setDuration(i * 3);
+    fillIOs(nodes[i].initInputs(IOS_PER_NODE), "in");
+    fillIOs(nodes[i].initOutputs(IOS_PER_NODE), "out");
+  }
+}
+
+// The wvalue conversion GET /api/nodes used before NodeJsonWriter; it
+// writes the same document.
+crow::json::wvalue convertFlexValueToJson(const FlexValueCap::Reader& flex) {
+  if (flex.isIntVal()) {
+    return crow::json::wvalue(static_cast<std::int64_t>(flex.getIntVal()));
+  } else if (flex.isUintVal()) {
+    return crow::json::wvalue(static_cast<std::uint64_t>(flex.getUintVal()));
+  } else if (flex.isBoolVal()) {
+    return crow::json::wvalue(flex.getBoolVal());
+  } else if (flex.isDoubleVal()) {
+    return crow::json::wvalue(flex.getDoubleVal());
+  } else if (flex.isStringVal()) {
+    return crow::json::wvalue(std::string(flex.getStringVal().cStr()));
+  }
+  return crow::json::wvalue(nullptr);
+}
+
+crow::json::wvalue convertIOToJson(const IO::Reader& io) {
+  crow::json::wvalue json;
+  json["name"] = std::string(io.getName().cStr());
+  json["value"] = convertFlexValueToJson(io.getValue());
+  json["override"] = io.getOverride();
+  json["override_value"] = convertFlexValueToJson(io.getOverrideValue());
+  json["default_value"] = convertFlexValueToJson(io.getDefaultValue());
+  return json;
+}
+
+crow::json::wvalue convertOutputIOToJson(const IO::Reader& io) {
+  crow::json::wvalue json;
+  json["name"] = std::string(io.getName().cStr());
+  json["value"] = convertFlexValueToJson(io.getValue());
+  json["override"] = io.getOverride();
+  json["override_value"] = convertFlexValueToJson(io.getOverrideValue());
+  json["fallback_value"] = convertFlexValueToJson(io.getDefaultValue());  // renamed for outputs
+  return json;
+}
+
+crow::json::wvalue convertNodeToJson(const Node::Reader& node) {
+  crow::json::wvalue json;
+  json["instanceId"] = static_cast<uint32_t>(node.getInstanceId());
+  json["nodeName"] = std::string(node.getNodeName().cStr());
+  json["hasChildren"] = node.getHasChildren();
+
+  // Add NodeStatus
+  auto nodeStatus = node.getNodeStatus();
+  json["nodeStatus"]["status"] = std::string(nodeStatus.getStatus().cStr());
+  json["nodeStatus"]["count"] = static_cast<uint32_t>(nodeStatus.getCount());
+  json["nodeStatus"]["duration"] = static_cast<uint32_t>(nodeStatus.getDuration());
+
+  json["inputs"] = crow::json::wvalue::list();
+  auto inputs = node.getInputs();
+  for (size_t i = 0; i < inputs.size(); i++) {
+    json["inputs"][i] = convertIOToJson(inputs[i]);
+  }
+
+  json["outputs"] = crow::json::wvalue::list();
+  auto outputs = node.getOutputs();
+  for (size_t i = 0; i < outputs.size(); i++) {
+    json["outputs"][i] = convertOutputIOToJson(outputs[i]);
+  }
+
+  return json;
+}
+
+// Fixture state shared by the benchmarks: one message per node count.
+struct Nodes {
+  explicit Nodes(uint32_t count) {
+    fillMessage(message, count);
+  }
+
+  capnp::List<Node, capnp::Kind::STRUCT>::Reader get() {
+    return message.getRoot<Engine::GetAllValuesResults>().asReader().getNodes();
+  }
+
+  uint64_t ioCount() {
+    return static_cast<uint64_t>(get().size()) * IOS_PER_NODE * 2;
+  }
+
+  capnp::MallocMessageBuilder message;
+};
+
+// Reports ns/IO and allocs/IO for `ios` IOs handled per iteration.
+void report(benchmark::State& state, uint64_t ios, uint64_t allocationsBefore) {
+  uint64_t total = ios * state.iterations();
+  state.SetItemsProcessed(total);
+  state.counters["ns/IO"] = benchmark::Counter(static_cast<double>(total) * 1e-9,
+                                               benchmark::Counter::kIsRate | benchmark::Counter::kInvert);
+  state.counters["allocs/IO"] = static_cast<double>(allocations - allocationsBefore) / total;
+}
+
+void BM_ConvertFlexValueToJson(benchmark::State& state) {
+  Nodes nodes(state.range(0));
+  uint64_t before = allocations;
+  for (auto _ : state) {
+    for (auto node : nodes.get()) {
+      for (auto io : node.getInputs()) {
+        benchmark::DoNotOptimize(convertFlexValueToJson(io.getValue()));
+      }
+      for (auto io : node.getOutputs()) {
+        benchmark::DoNotOptimize(convertFlexValueToJson(io.getValue()));
+      }
+    }
+  }
+  report(state, nodes.ioCount(), before);
+}
+
+void BM_ConvertIOToJson(benchmark::State& state) {
+  Nodes nodes(state.range(0));
+  uint64_t before = allocations;
+  for (auto _ : state) {
+    for (auto node : nodes.get()) {
+      for (auto io : node.getInputs()) {
+        benchmark::DoNotOptimize(convertIOToJson(io));
+      }
+      for (auto io : node.getOutputs()) {
+        benchmark::DoNotOptimize(convertOutputIOToJson(io));
+      }
+    }
+  }
+  report(state, nodes.ioCount(), before);
+}
+
+void BM_ConvertNodeToJson(benchmark::State& state) {
+  Nodes nodes(state.range(0));
+  uint64_t before = allocations;
+  for (auto _ : state) {
+    for (auto node : nodes.get()) {
+      benchmark::DoNotOptimize(convertNodeToJson(node));
+    }
+  }
+  report(state, nodes.ioCount(), before);
+}
+
+// The old GET /api/nodes path end to end: wvalue tree, then dump().
+void BM_ConvertNodesAndDump(benchmark::State& state) {
+  Nodes nodes(state.range(0));
+  uint64_t before = allocations;
+  for (auto _ : state) {
+    crow::json::wvalue json = crow::json::wvalue::list();
+    auto list = nodes.get();
+    for (size_t i = 0; i < list.size(); i++) {
+      json[i] = convertNodeToJson(list[i]);
+    }
+    benchmark::DoNotOptimize(json.dump());
+  }
+  report(state, nodes.ioCount(), before);
+}
+
+void BM_NodeJsonWriter(benchmark::State& state) {
+  Nodes nodes(state.range(0));
+  std::string out;
+  uint64_t before = allocations;
+  for (auto _ : state) {
+    out.clear();
+    NodeJsonWriter(out).writeNodes(nodes.get());
+    benchmark::DoNotOptimize(out.data());
+  }
+  report(state, nodes.ioCount(), before);
+  state.counters["bytes/IO"] = static_cast<double>(out.size()) / nodes.ioCount();
+}
+
+// The same document as BM_NodeJsonWriter, as CBOR (0) or MessagePack (1).
+void BM_NodeBinaryWriter(benchmark::State& state) {
+  Nodes nodes(state.range(0));
+  auto format = state.range(1) == 0 ? NodeBinaryWriter::Format::CBOR : NodeBinaryWriter::Format::MSGPACK;
+  state.SetLabel(NodeBinaryWriter::contentType(format));
+  std::string out;
+  uint64_t before = allocations;
+  for (auto _ : state) {
+    out.clear();
+    NodeBinaryWriter(out, format).writeNodes(nodes.get());
+    benchmark::DoNotOptimize(out.data());
+  }
+  report(state, nodes.ioCount(), before);
+  state.counters["bytes/IO"] = static_cast<double>(out.size()) / nodes.ioCount();
+}
+
+void BM_SetFlexValue(benchmark::State& state) {
+  std::string text = "[";
+  for (int64_t i = 0; i < state.range(0) * IOS_PER_NODE * 2; i++) {
+    static const char* const samples[] = {"-17", "42", "true", "3.25", "\"value\""};
+    text += (i > 0 ? "," : "") + std::string(samples[i % 5]);
+  }
+  text += "]";
+  auto values = crow::json::load(text);
+  uint32_t count = values.size();
+
+  uint64_t before = allocations;
+  for (auto _ : state) {
+    // A fresh builder each round so string values don't pile up in one arena.
+    capnp::MallocMessageBuilder message(count * 8);
+    auto list = message.initRoot<capnp::List<FlexValueCap>>(count);
+    for (uint32_t i = 0; i < count; i++) {
+      EngineService::setFlexValue(list[i], values[i]);
+    }
+    benchmark::DoNotOptimize(list);
+  }
+  report(state, count, before);
+}
+
+// Request bodies of POST /api/nodes (0), POST /api/edges (1) and
+// PUT /api/nodes/<id>/override (2).
+const char* const WRITE_BODIES[] = {
+    R"({"packageId": 3, "nodeId": 12, "parentId": 0, "posX": 240, "posY": -80})",
+    R"({"fromInstanceId": 17, "toInstanceId": 42, "outName": "out0", "inName": "in3"})",
+    R"({"name": "in3", "value": 12.5, "duration": 5000, "active": true, "input": true})",
+};
+const char* const WRITE_SHAPES[] = {"NodeDetails", "EdgeMessage", "SetOverrideParams"};
+
+void reportBodies(benchmark::State& state, uint64_t allocationsBefore) {
+  state.SetItemsProcessed(state.iterations());
+  state.counters["allocs/body"] = static_cast<double>(allocations - allocationsBefore) / state.iterations();
+}
+
+// The write routes before JsonBodyParser: an rvalue tree, then each field
+// copied into the builder.
+void BM_LoadWriteBody(benchmark::State& state) {
+  std::string body = WRITE_BODIES[state.range(0)];
+  state.SetLabel(WRITE_SHAPES[state.range(0)]);
+  uint64_t before = allocations;
+  for (auto _ : state) {
+    capnp::MallocMessageBuilder message;
+    auto x = crow::json::load(body);
+    if (state.range(0) == 0) {
+      auto details = message.initRoot<NodeDetails>();
+      details.setPackageId(x["packageId"].u());
+      details.setNodeId(x["nodeId"].u());
+      details.setParentId(x["parentId"].u());
+      details.setPosX(x["posX"].i());
+      details.setPosY(x["posY"].i());
+    } else if (state.range(0) == 1) {
+      auto edge = message.initRoot<EdgeMessage>();
+      edge.setFromInstanceId(x["fromInstanceId"].u());
+      edge.setToInstanceId(x["toInstanceId"].u());
+      edge.setOutName(std::string(x["outName"].s()));
+      edge.setInName(std::string(x["inName"].s()));
+    } else {
+      auto params = message.initRoot<Engine::SetOverrideParams>();
+      params.getOverride().setName(std::string(x["name"].s()));
+      EngineService::setFlexValue(params.getOverride().getValue(), x["value"]);
+      params.setDuration(x["duration"].u());
+      params.setActive(x["active"].b());
+      params.setInput(x["input"].b());
+    }
+    benchmark::DoNotOptimize(message.getSegmentsForOutput());
+  }
+  reportBodies(state, before);
+}
+
+void BM_ParseWriteBody(benchmark::State& state) {
+  std::string body = WRITE_BODIES[state.range(0)];
+  state.SetLabel(WRITE_SHAPES[state.range(0)]);
+  uint64_t before = allocations;
+  for (auto _ : state) {
+    capnp::MallocMessageBuilder message;
+    std::string error;
+    if (state.range(0) == 0) {
+      error = JsonBodyParser::nodeDetails(body, message.initRoot<NodeDetails>());
+    } else if (state.range(0) == 1) {
+      error = JsonBodyParser::edge(body, message.initRoot<EdgeMessage>());
+    } else {
+      error = JsonBodyParser::override(body, message.initRoot<Engine::SetOverrideParams>());
+    }
+    if (!error.empty()) {
+      state.SkipWithError(error.c_str());
+      break;
+    }
+    benchmark::DoNotOptimize(message.getSegmentsForOutput());
+  }
+  reportBodies(state, before);
+}
+
+BENCHMARK(BM_ConvertFlexValueToJson)->Arg(10)->Arg(100)->Arg(1000);
+BENCHMARK(BM_ConvertIOToJson)->Arg(10)->Arg(100)->Arg(1000);
+BENCHMARK(BM_ConvertNodeToJson)->Arg(10)->Arg(100)->Arg(1000);
+BENCHMARK(BM_ConvertNodesAndDump)->Arg(10)->Arg(100)->Arg(1000);
+BENCHMARK(BM_NodeJsonWriter)->Arg(10)->Arg(100)->Arg(1000);
+BENCHMARK(BM_NodeBinaryWriter)->ArgsProduct({{10, 100, 1000}, {0, 1}});
+BENCHMARK(BM_SetFlexValue)->Arg(10)->Arg(100)->Arg(1000);
+BENCHMARK(BM_LoadWriteBody)->DenseRange(0, 2);
+BENCHMARK(BM_ParseWriteBody)->DenseRange(0, 2);
+
+}  // namespace
+
+// Counts every heap allocation for the allocs/IO counters.
+void* operator new(std::size_t size) {
+  allocations.fetch_add(1, std::memory_order_relaxed);
+  if (void* p = std::malloc(size ? size : 1)) {
+    return p;
+  }
+  throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept {
+  std::free(p);
+}
+
+void operator delete(void* p, std::size_t) noexcept {
+  std::free(p);
+}
+
+BENCHMARK_MAIN();
@@ -0,0 +1,290 @@
+//
+// Created by craig on 17/10/2026.
+//
+
+#ifndef MOCK_ENGINE_HPP_
+#define MOCK_ENGINE_HPP_
+
+#include <capnp/rpc-twoparty.h>
+#include <kj/async-io.h>
+#include <unistd.h>
+#include <chrono>
+#include <cstdlib>
+#include <map>
+#include <random>
+#include <string>
+#include <vector>
+#include "../schemas/package.capnp.h"
+
+// Synthetic Engine for benchmarking the gateway without the real engine.
+// Serves `nodes` nodes with `ios` inputs and `ios` outputs each; every
+// getAllValues moves roughly `churn` of the outputs to a new value, and
+// every call is answered after `latency`.
+class MockEngine final : public Engine::Server {
+ public:
+  struct Config {
+    uint32_t nodes = 1000;
+    uint32_t ios = 8;
+    double churn = 0.1;  // fraction of outputs changed per getAllValues
+    std::chrono::microseconds latency{0};
+    uint32_t packages = 4;
+  };
+
+  MockEngine(const Config& config, kj::Timer& timer) : config(config), timer(timer), random(42) {
+    for (uint32_t i = 0; i < config.nodes; i++) {
+      add(i % 16);
+    }
+  }
+
+  kj::Promise<void> addNode(AddNodeContext context) override {
+    auto details = context.getParams().getNodeDetails();
+    auto& node = add(details.getNodeId());
+    auto results = context.getResults();
+    results.setInstanceId(node.instanceId);
+    results.setName(node.name);
+    return delay();
+  }
+
+  kj::Promise<void> updateNode(UpdateNodeContext context) override {
+    auto details = context.getParams().getNodeDetails();
+    auto found = nodes.find(details.getInstanceId());
+    KJ_REQUIRE(found != nodes.end(), "unknown instance", details.getInstanceId());
+    found->second.posX = details.getPosX();
+    found->second.posY = details.getPosY();
+    auto results = context.getResults();
+    results.setInstanceId(found->first);
+    results.setName(found->second.name);
+    return delay();
+  }
+
+  kj::Promise<void> removeNode(RemoveNodeContext context) override {
+    auto instanceId = context.getParams().getInstanceId();
+    KJ_REQUIRE(nodes.erase(instanceId) == 1, "unknown instance", instanceId);
+    context.getResults().setInstanceId(instanceId);
+    return delay();
+  }
+
+  kj::Promise<void> addEdge(AddEdgeContext context) override {
+    auto edge = context.getParams().getEdge();
+    KJ_REQUIRE(nodes.count(edge.getFromInstanceId()) && nodes.count(edge.getToInstanceId()), "unknown instance");
+    uint32_t edgeId = nextEdgeId++;
+    edges.emplace(edgeId, std::make_pair(edge.getFromInstanceId(), edge.getToInstanceId()));
+    auto results = context.getResults();
+    results.setEdgeId(edgeId);
+    results.setDataOnly(true);
+    return delay();
+  }
+
+  kj::Promise<void> removeEdge(RemoveEdgeContext context) override {
+    auto edgeId = context.getParams().getEdgeId();
+    KJ_REQUIRE(edges.erase(edgeId) == 1, "unknown edge", edgeId);
+    context.getResults().setEdgeId(edgeId);
+    return delay();
+  }
+
+  kj::Promise<void> setDefault(SetDefaultContext context) override {
+    auto params = context.getParams();
+    auto& io = findInput(params.getInstanceId(), params.getDefault().getName());
+    io.defaultValue = numeric(params.getDefault().getValue());
+    return delay();
+  }
+
+  kj::Promise<void> setOverride(SetOverrideContext context) override {
+    auto params = context.getParams();
+    auto& io = params.getInput() ? findInput(params.getInstanceId(), params.getOverride().getName())
+                                 : findOutput(params.getInstanceId(), params.getOverride().getName());
+    io.override = params.getActive();
+    io.overrideValue = numeric(params.getOverride().getValue());
+    return delay();
+  }
+
+  kj::Promise<void> setFallback(SetFallbackContext context) override {
+    auto params = context.getParams();
+    auto& io = findOutput(params.getInstanceId(), params.getFallback().getName());
+    io.defaultValue = numeric(params.getFallback().getValue());
+    return delay();
+  }
+
+  kj::Promise<void> getAllValues(GetAllValuesContext context) override {
+    churnValues();
+    auto list = context.getResults().initNodes(nodes.size());
+    uint32_t i = 0;
+    for (auto& [instanceId, node] : nodes) {
+      auto out = list[i++];
+      out.setInstanceId(instanceId);
+      out.setNodeName(node.name);
+      out.setHasChildren(false);
+      auto status = out.initNodeStatus();
+      status.setStatus("ok");
+      status.setCount(node.count);
+      status.setDuration(node.count % 1000);
+      writeIOs(out.initInputs(node.inputs.size()), node.inputs);
+      writeIOs(out.initOutputs(node.outputs.size()), node.outputs);
+    }
+    return delay();
+  }
+
+  kj::Promise<void> getAvailablePackages(GetAvailablePackagesContext context) override {
+    auto list = context.getResults().initAvailablePackages(config.packages);
+    for (uint32_t i = 0; i < config.packages; i++) {
+      list[i].setPackageId(i);
+      list[i].setPackageName(kj::str("mock-package-", i));
+      list[i].setPackageVersion("1.0.0");
+      list[i].setDetailsFilePath(kj::str("/tmp/mock-package-", i, ".json"));
+    }
+    return delay();
+  }
+
+  kj::Promise<void> getPackageJson(GetPackageJsonContext context) override {
+    auto packageId = context.getParams().getPackageId();
+    KJ_REQUIRE(packageId < config.packages, "unknown package", packageId);
+    std::string json = "{\"packageId\":" + std::to_string(packageId) + ",\"nodes\":[";
+    for (uint32_t i = 0; i < 16; i++) {
+      json += (i > 0 ? ",{\"nodeId\":" : "{\"nodeId\":") + std::to_string(i) + ",\"name\":\"mock" +
+          std::to_string(i) + "\"}";
+    }
+    json += "]}";
+    context.getResults().setJsonData(json);
+    return delay();
+  }
+
+  kj::Promise<void> getFlowJson(GetFlowJsonContext context) override {
+    std::string json = "{\"nodes\":[";
+    bool first = true;
+    for (auto& [instanceId, node] : nodes) {
+      json += first ? "" : ",";
+      json += "{\"instanceId\":" + std::to_string(instanceId) + ",\"posX\":" + std::to_string(node.posX) +
+          ",\"posY\":" + std::to_string(node.posY) + "}";
+      first = false;
+    }
+    json += "],\"edges\":[";
+    first = true;
+    for (auto& [edgeId, ends] : edges) {
+      json += first ? "" : ",";
+      json += "{\"edgeId\":" + std::to_string(edgeId) + ",\"from\":" + std::to_string(ends.first) +
+          ",\"to\":" + std::to_string(ends.second) + "}";
+      first = false;
+    }
+    json += "]}";
+    context.getResults().setJsonData(json);
+    return delay();
+  }
+
+  // Listens on `socketPath` and serves until the process exits.
+  static void serve(const Config& config, const std::string& socketPath) {
+    unlink(socketPath.c_str());
+    auto io = kj::setupAsyncIo();
+    auto address = io.provider->getNetwork().parseAddress(kj::str("unix:", socketPath.c_str()))
+        .wait(io.waitScope);
+    auto listener = address->listen();
+    capnp::TwoPartyServer server(kj::heap<MockEngine>(config, io.provider->getTimer()));
+    server.listen(*listener).wait(io.waitScope);
+  }
+
+ private:
+  struct MockIO {
+    std::string name;
+    double value = 0;
+    bool override = false;
+    double overrideValue = 0;
+    double defaultValue = 0;
+  };
+
+  struct MockNode {
+    uint32_t instanceId;
+    std::string name;
+    int32_t posX = 0;
+    int32_t posY = 0;
+    uint32_t count = 0;
+    std::vector<MockIO> inputs;
+    std::vector<MockIO> outputs;
+  };
+
+  const Config config;
+  kj::Timer& timer;
+  std::mt19937 random;
+  std::map<uint32_t, MockNode> nodes;
+  std::map<uint32_t, std::pair<uint32_t, uint32_t>> edges;
+  uint32_t nextInstanceId = 1;
+  uint32_t nextEdgeId = 1;
+
+  MockNode& add(uint32_t nodeId) {
+    uint32_t instanceId = nextInstanceId++;
+    auto& node = nodes[instanceId];
+    node.instanceId = instanceId;
+    node.name = "mock" + std::to_string(nodeId) + "_" + std::to_string(instanceId);
+    for (uint32_t i = 0; i < config.ios; i++) {
+      node.inputs.push_back(MockIO{"in" + std::to_string(i)});
+      node.outputs.push_back(MockIO{"out" + std::to_string(i)});
+    }
+    return node;
+  }
+
+  kj::Promise<void> delay() {
+    if (config.latency.count() == 0) {
+      return kj::READY_NOW;
+    }
+    return timer.afterDelay(config.latency.count() * kj::MICROSECONDS);
+  }
+
+  void churnValues() {
+    std::uniform_real_distribution<double> pick(0.0, 1.0);
+    for (auto& [instanceId, node] : nodes) {
+      bool changed = false;
+      for (auto& io : node.outputs) {
+        if (pick(random) < config.churn) {
+          io.value = pick(random) * 100;
+          changed = true;
+        }
+      }
+      if (changed) {
+        node.count++;
+      }
+    }
+  }
+
+  static void writeIOs(capnp::List<IO, capnp::Kind::STRUCT>::Builder out, const std::vector<MockIO>& ios) {
+    for (uint32_t i = 0; i < ios.size(); i++) {
+      auto& io = ios[i];
+      out[i].setName(io.name);
+      out[i].getValue().setDoubleVal(io.value);
+      out[i].setOverride(io.override);
+      out[i].getOverrideValue().setDoubleVal(io.overrideValue);
+      out[i].getDefaultValue().setDoubleVal(io.defaultValue);
+    }
+  }
+
+  static double numeric(FlexValueCap::Reader value) {
+    switch (value.which()) {
+      case FlexValueCap::INT_VAL: return value.getIntVal();
+      case FlexValueCap::UINT_VAL: return value.getUintVal();
+      case FlexValueCap::BOOL_VAL: return value.getBoolVal() ? 1 : 0;
+      case FlexValueCap::DOUBLE_VAL: return value.getDoubleVal();
+      case FlexValueCap::STRING_VAL: return std::atof(value.getStringVal().cStr());
+    }
+    return 0;
+  }
+
+  MockIO& findIO(std::vector<MockIO>& ios, capnp::Text::Reader name) {
+    for (auto& io : ios) {
+      if (io.name == name.cStr()) {
+        return io;
+      }
+    }
+    KJ_FAIL_REQUIRE("unknown IO", name);
+  }
+
+  MockIO& findInput(uint32_t instanceId, capnp::Text::Reader name) {
+    auto found = nodes.find(instanceId);
+    KJ_REQUIRE(found != nodes.end(), "unknown instance", instanceId);
+    return findIO(found->second.inputs, name);
+  }
+
+  MockIO& findOutput(uint32_t instanceId, capnp::Text::Reader name) {
+    auto found = nodes.find(instanceId);
+    KJ_REQUIRE(found != nodes.end(), "unknown instance", instanceId);
+    return findIO(found->second.outputs, name);
+  }
+};
+
+#endif //MOCK_ENGINE_HPP_
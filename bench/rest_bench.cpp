@@ -0,0 +1,376 @@
+//
+// Created by craig on 17/10/2026.
+//
+// Load generator for ce-rest-api. Starts a MockEngine on the engine socket
+// in this process, then drives each REST route from a pool of keep-alive
+// connections and reports throughput and latency percentiles:
+//
+//   ce-rest-bench --nodes 2000 --ios 8 --churn 0.2 --threads 16 --seconds 10 &
+//   ce-rest-api
+//
+// --serve-only runs just the mock engine; --no-engine benchmarks a gateway
+// that is already connected to a real one.
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <functional>
+#include <iostream>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+#include "mock_engine.hpp"
+
+namespace {
+
+struct Options {
+  MockEngine::Config engine;
+  std::string socketPath = "/tmp/engine-socket";
+  std::string host = "127.0.0.1";
+  uint16_t port = 1668;
+  uint32_t threads = 8;
+  uint32_t seconds = 5;
+  std::string only;  // run scenarios whose name contains this
+  bool serveOnly = false;
+  bool noEngine = false;
+};
+
+struct Response {
+  int status = 0;
+  std::string body;
+};
+
+// Minimal blocking HTTP/1.1 client over one keep-alive connection.
+class HttpClient {
+ public:
+  HttpClient(const std::string& host, uint16_t port) : host(host), port(port) {}
+
+  ~HttpClient() {
+    disconnect();
+  }
+
+  bool request(const char* method, const std::string& path, const std::string& body, Response& out) {
+    for (int attempt = 0; attempt < 2; attempt++) {
+      if (fd < 0 && !connect()) {
+        return false;
+      }
+      std::string message = std::string(method) + " " + path + " HTTP/1.1\r\nHost: " + host +
+          "\r\nContent-Type: application/json\r\nContent-Length: " + std::to_string(body.size()) +
+          "\r\n\r\n" + body;
+      if (sendAll(message) && readResponse(out)) {
+        return true;
+      }
+      disconnect();
+    }
+    return false;
+  }
+
+ private:
+  const std::string host;
+  const uint16_t port;
+  int fd = -1;
+  std::string buffer;
+
+  bool connect() {
+    fd = socket(AF_INET, SOCK_STREAM, 0);
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    inet_pton(AF_INET, host.c_str(), &addr.sin_addr);
+    if (::connect(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0) {
+      disconnect();
+      return false;
+    }
+    int one = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    return true;
+  }
+
+  void disconnect() {
+    if (fd >= 0) {
+      close(fd);
+      fd = -1;
+    }
+    buffer.clear();
+  }
+
+  bool sendAll(const std::string& data) {
+    size_t sent = 0;
+    while (sent < data.size()) {
+      ssize_t n = send(fd, data.data() + sent, data.size() - sent, MSG_NOSIGNAL);
+      if (n <= 0) {
+        return false;
+      }
+      sent += n;
+    }
+    return true;
+  }
+
+  bool fill() {
+    char chunk[16384];
+    ssize_t n = recv(fd, chunk, sizeof(chunk), 0);
+    if (n <= 0) {
+      return false;
+    }
+    buffer.append(chunk, n);
+    return true;
+  }
+
+  bool readResponse(Response& out) {
+    size_t headerEnd;
+    while ((headerEnd = buffer.find("\r\n\r\n")) == std::string::npos) {
+      if (!fill()) {
+        return false;
+      }
+    }
+    out.status = std::atoi(buffer.c_str() + 9);  // "HTTP/1.1 200"
+
+    size_t length = 0;
+    std::string headers = buffer.substr(0, headerEnd);
+    std::transform(headers.begin(), headers.end(), headers.begin(), ::tolower);
+    auto found = headers.find("content-length:");
+    if (found != std::string::npos) {
+      length = std::strtoul(headers.c_str() + found + 15, nullptr, 10);
+    }
+
+    size_t total = headerEnd + 4 + length;
+    while (buffer.size() < total) {
+      if (!fill()) {
+        return false;
+      }
+    }
+    out.body.assign(buffer, headerEnd + 4, length);
+    buffer.erase(0, total);
+    return true;
+  }
+};
+
+// Per-thread context handed to a scenario step.
+struct Worker {
+  HttpClient client;
+  std::mt19937 random;
+  const Options& options;
+  Response response;
+
+  uint32_t randomNode() {
+    return std::uniform_int_distribution<uint32_t>(1, options.engine.nodes)(random);
+  }
+
+  bool call(const char* method, const std::string& path, const std::string& body = "") {
+    return client.request(method, path, body, response) && response.status < 400;
+  }
+};
+
+struct Scenario {
+  const char* name;
+  std::function<bool(Worker&)> step;  // one iteration; false on error
+};
+
+uint32_t jsonUint(const std::string& body, const char* key) {
+  auto found = body.find(key);
+  return found == std::string::npos ? 0 : std::strtoul(body.c_str() + found + strlen(key), nullptr, 10);
+}
+
+// A PUT /api/nodes/values/batch body of `count` writes cycling through
+// default, override and fallback.
+std::string valueBatch(Worker& w, uint32_t count) {
+  std::string body = "[";
+  for (uint32_t i = 0; i < count; i++) {
+    body += i > 0 ? ",{\"instanceId\":" : "{\"instanceId\":";
+    body += std::to_string(w.randomNode());
+    switch (i % 3) {
+      case 0: body += ",\"kind\":\"default\",\"name\":\"in0\",\"value\":" + std::to_string(i) + "}"; break;
+      case 1: body += ",\"kind\":\"override\",\"name\":\"in0\",\"value\":1.5,\"duration\":0,\"active\":true,"
+                        "\"input\":true}"; break;
+      default: body += ",\"kind\":\"fallback\",\"name\":\"out0\",\"value\":2}"; break;
+    }
+  }
+  return body + "]";
+}
+
+std::vector<Scenario> scenarios() {
+  return {
+      {"GET /api/nodes", [](Worker& w) { return w.call("GET", "/api/nodes"); }},
+      {"GET /api/nodes?since=", [](Worker& w) { return w.call("GET", "/api/nodes?since=1"); }},
+      {"GET /api/nodes?fields=", [](Worker& w) {
+        return w.call("GET", "/api/nodes?fields=instanceId,outputs.value");
+      }},
+      {"GET /api/nodes/{id}", [](Worker& w) {
+        return w.call("GET", "/api/nodes/" + std::to_string(w.randomNode()));
+      }},
+      {"PUT /api/nodes", [](Worker& w) {
+        return w.call("PUT", "/api/nodes", "{\"instanceId\":" + std::to_string(w.randomNode()) +
+            ",\"posX\":" + std::to_string(w.random() % 1000) + ",\"posY\":" + std::to_string(w.random() % 1000) + "}");
+      }},
+      {"PUT /api/nodes/{id}/default", [](Worker& w) {
+        return w.call("PUT", "/api/nodes/" + std::to_string(w.randomNode()) + "/default",
+                      "{\"name\":\"in0\",\"value\":" + std::to_string(w.random() % 100) + "}");
+      }},
+      {"PUT /api/nodes/{id}/override", [](Worker& w) {
+        return w.call("PUT", "/api/nodes/" + std::to_string(w.randomNode()) + "/override",
+                      "{\"name\":\"in0\",\"value\":1.5,\"duration\":0,\"active\":true,\"input\":true}");
+      }},
+      {"PUT /api/nodes/{id}/fallback", [](Worker& w) {
+        return w.call("PUT", "/api/nodes/" + std::to_string(w.randomNode()) + "/fallback",
+                      "{\"name\":\"out0\",\"value\":2}");
+      }},
+      {"PUT /api/nodes/values/batch x10", [](Worker& w) {
+        return w.call("PUT", "/api/nodes/values/batch", valueBatch(w, 10));
+      }},
+      {"PUT /api/nodes/values/batch x100", [](Worker& w) {
+        return w.call("PUT", "/api/nodes/values/batch", valueBatch(w, 100));
+      }},
+      {"POST+DELETE /api/nodes", [](Worker& w) {
+        if (!w.call("POST", "/api/nodes", "{\"packageId\":0,\"nodeId\":1,\"parentId\":0,\"posX\":0,\"posY\":0}")) {
+          return false;
+        }
+        return w.call("DELETE", "/api/nodes/" + std::to_string(jsonUint(w.response.body, "\"instanceId\":")));
+      }},
+      {"POST+DELETE /api/edges", [](Worker& w) {
+        if (!w.call("POST", "/api/edges", "{\"fromInstanceId\":" + std::to_string(w.randomNode()) +
+            ",\"toInstanceId\":" + std::to_string(w.randomNode()) + ",\"outName\":\"out0\",\"inName\":\"in0\"}")) {
+          return false;
+        }
+        return w.call("DELETE", "/api/edges/" + std::to_string(jsonUint(w.response.body, "\"edgeId\":")));
+      }},
+      {"POST /api/graph/batch", [](Worker& w) {
+        return w.call("POST", "/api/graph/batch",
+                      "{\"ops\":[{\"op\":\"addNode\",\"tempId\":\"a\",\"packageId\":0,\"nodeId\":1},"
+                      "{\"op\":\"addNode\",\"tempId\":\"b\",\"packageId\":0,\"nodeId\":2},"
+                      "{\"op\":\"addEdge\",\"fromInstanceId\":\"a\",\"toInstanceId\":\"b\","
+                      "\"outName\":\"out0\",\"inName\":\"in0\"},"
+                      "{\"op\":\"removeNode\",\"instanceId\":\"a\"},"
+                      "{\"op\":\"removeNode\",\"instanceId\":\"b\"}]}");
+      }},
+      {"GET /api/packages", [](Worker& w) { return w.call("GET", "/api/packages"); }},
+      {"GET /api/packages/{id}/json", [](Worker& w) { return w.call("GET", "/api/packages/0/json"); }},
+      {"GET /api/flow", [](Worker& w) { return w.call("GET", "/api/flow"); }},
+      {"GET /metrics", [](Worker& w) { return w.call("GET", "/metrics"); }},
+  };
+}
+
+double percentile(const std::vector<uint32_t>& sorted, double p) {
+  if (sorted.empty()) {
+    return 0;
+  }
+  size_t index = std::min(sorted.size() - 1, static_cast<size_t>(p * sorted.size()));
+  return sorted[index] / 1000.0;
+}
+
+void run(const Scenario& scenario, const Options& options) {
+  std::vector<std::vector<uint32_t>> latencies(options.threads);
+  std::atomic<uint64_t> errors{0};
+  auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(options.seconds);
+
+  std::vector<std::thread> threads;
+  for (uint32_t t = 0; t < options.threads; t++) {
+    threads.emplace_back([&, t]() {
+      Worker worker{HttpClient(options.host, options.port), std::mt19937(t + 1), options};
+      auto& samples = latencies[t];
+      while (true) {
+        auto start = std::chrono::steady_clock::now();
+        if (start >= deadline) {
+          break;
+        }
+        bool ok = scenario.step(worker);
+        auto elapsed = std::chrono::steady_clock::now() - start;
+        samples.push_back(std::chrono::duration_cast<std::chrono::microseconds>(elapsed).count());
+        if (!ok) {
+          errors++;
+        }
+      }
+    });
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+
+  std::vector<uint32_t> all;
+  for (auto& samples : latencies) {
+    all.insert(all.end(), samples.begin(), samples.end());
+  }
+  std::sort(all.begin(), all.end());
+  printf("%-32s %10.0f %10.3f %10.3f %10.3f %8lu\n", scenario.name,
+         all.size() / static_cast<double>(options.seconds),
+         percentile(all, 0.5), percentile(all, 0.99), percentile(all, 0.999),
+         static_cast<unsigned long>(errors.load()));
+}
+
+bool waitForGateway(const Options& options) {
+  HttpClient client(options.host, options.port);
+  Response response;
+  for (int i = 0; i < 100; i++) {
+    if (client.request("GET", "/api/packages", "", response) && response.status == 200) {
+      return true;
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+  }
+  return false;
+}
+
+Options parse(int argc, char** argv) {
+  Options options;
+  for (int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+    auto next = [&]() -> const char* {
+      if (i + 1 >= argc) {
+        std::cerr << "Missing value for " << arg << std::endl;
+        std::exit(2);
+      }
+      return argv[++i];
+    };
+    if (arg == "--nodes") options.engine.nodes = std::atoi(next());
+    else if (arg == "--ios") options.engine.ios = std::atoi(next());
+    else if (arg == "--churn") options.engine.churn = std::atof(next());
+    else if (arg == "--latency-us") options.engine.latency = std::chrono::microseconds(std::atoi(next()));
+    else if (arg == "--socket") options.socketPath = next();
+    else if (arg == "--host") options.host = next();
+    else if (arg == "--port") options.port = std::atoi(next());
+    else if (arg == "--threads") options.threads = std::max(1, std::atoi(next()));
+    else if (arg == "--seconds") options.seconds = std::max(1, std::atoi(next()));
+    else if (arg == "--only") options.only = next();
+    else if (arg == "--serve-only") options.serveOnly = true;
+    else if (arg == "--no-engine") options.noEngine = true;
+    else {
+      std::cerr << "Unknown option " << arg << std::endl;
+      std::exit(2);
+    }
+  }
+  return options;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  Options options = parse(argc, argv);
+
+  if (!options.noEngine) {
+    std::thread engine([&options]() { MockEngine::serve(options.engine, options.socketPath); });
+    if (options.serveOnly) {
+      engine.join();
+      return 0;
+    }
+    engine.detach();
+  }
+
+  if (!waitForGateway(options)) {
+    std::cerr << "ce-rest-api is not answering on " << options.host << ":" << options.port << std::endl;
+    return 1;
+  }
+
+  printf("%-32s %10s %10s %10s %10s %8s\n", "scenario", "req/s", "p50 ms", "p99 ms", "p999 ms", "errors");
+  for (auto& scenario : scenarios()) {
+    if (options.only.empty() || std::string(scenario.name).find(options.only) != std::string::npos) {
+      run(scenario, options);
+    }
+  }
+  std::exit(0);  // the mock engine thread never returns
+}
@@ -0,0 +1,123 @@
+//
+// Created by craig on 17/10/2026.
+//
+
+#ifndef CAPNP_BODY_HPP_
+#define CAPNP_BODY_HPP_
+
+#include <capnp/message.h>
+#include <capnp/serialize.h>
+#include <cstring>
+#include <optional>
+#include "crow.h"
+#include "engine_service.hpp"
+#include "http_headers.hpp"
+
+// Cap'n Proto request and response bodies for machine clients, in the
+// standard stream framing (segment table, then segments). Routes use them
+// when a request sends Content-Type or Accept: application/x-capnp, with the
+// engine's own structs as the message types.
+struct CapnpBody {
+  static constexpr const char* CONTENT_TYPE = "application/x-capnp";
+
+  // Whether the Accept header prefers Cap'n Proto to JSON.
+  static bool accepted(const crow::request& req) {
+    return HttpHeaders::preferred(req.get_header_value("Accept"), {"application/json", CONTENT_TYPE}) == 1;
+  }
+
+  // The JSON answer of a route that sends Cap'n Proto to clients asking for
+  // it, so it varies by Accept like respond() does.
+  static crow::response json(crow::json::wvalue& value, int code = 200) {
+    crow::response res(value);
+    res.code = code;
+    res.add_header("Vary", "Accept");
+    return res;
+  }
+
+  // The ETag of the Cap'n Proto form of a representation whose JSON form
+  // has the strong ETag `jsonTag`.
+  static std::string etag(const std::string& jsonTag) {
+    return jsonTag.substr(0, jsonTag.size() - 1) + "-capnp\"";
+  }
+
+  static bool sent(const crow::request& req) {
+    return req.get_header_value("Content-Type").rfind(CONTENT_TYPE, 0) == 0;
+  }
+
+  // Parses the body as a T and passes its reader to func. Returns a 400
+  // response if the body is not a valid T. The whole message is checked
+  // before func runs, so func never meets a bad pointer, and exceptions from
+  // func are its caller's to handle.
+  template <typename T, typename Func>
+  static std::optional<crow::response> read(const crow::request& req, Func&& func) {
+    if (req.body.empty() || req.body.size() % sizeof(capnp::word) != 0) {
+      return crow::response(400, "Invalid Cap'n Proto body");
+    }
+    auto words = kj::heapArray<capnp::word>(req.body.size() / sizeof(capnp::word));
+    memcpy(words.begin(), req.body.data(), req.body.size());
+
+    kj::Own<capnp::FlatArrayMessageReader> reader;
+    typename T::Reader root;
+    auto error = kj::runCatchingExceptions([&]() {
+      reader = kj::heap<capnp::FlatArrayMessageReader>(words);
+      root = reader->getRoot<T>();
+      root.totalSize();  // walks every pointer
+    });
+    KJ_IF_MAYBE(e, error) {
+      return crow::response(400, std::string("Invalid Cap'n Proto body: ") + e->getDescription().cStr());
+    }
+    func(root);
+    return std::nullopt;
+  }
+
+  // As read(), for routes that also take JSON: any other body is parsed by
+  // parseJson(body, T::Builder) into a new T, which returns an empty string
+  // or the message for a 400. Either way func sees a T::Reader.
+  template <typename T, typename Parse, typename Func>
+  static std::optional<crow::response> readOrParse(const crow::request& req, Parse&& parseJson, Func&& func) {
+    if (sent(req)) {
+      return read<T>(req, func);
+    }
+    capnp::MallocMessageBuilder message;
+    auto root = message.initRoot<T>();
+    auto error = Metrics::global().timeJsonParse([&]() { return parseJson(req.body, root); });
+    if (!error.empty()) {
+      return crow::response(400, error);
+    }
+    func(root.asReader());
+    return std::nullopt;
+  }
+
+  // An engine response as it was received, framed without re-encoding.
+  template <typename T>
+  static crow::response respond(const EngineMessage<T>& message, int code = 200) {
+    auto words = message.words();
+    uint32_t table[2] = {0, static_cast<uint32_t>(words.size())};  // one segment
+    crow::response res(code);
+    res.body.reserve(sizeof(table) + words.asBytes().size());
+    res.body.append(reinterpret_cast<const char*>(table), sizeof(table));
+    res.body.append(reinterpret_cast<const char*>(words.begin()), words.asBytes().size());
+    res.set_header("Content-Type", CONTENT_TYPE);
+    res.add_header("Vary", "Accept");
+    return res;
+  }
+
+  // A new T message filled in by fill(T::Builder).
+  template <typename T, typename Func>
+  static crow::response build(Func&& fill, int code = 200) {
+    capnp::MallocMessageBuilder message;
+    fill(message.initRoot<T>());
+    return respond(message, code);
+  }
+
+  static crow::response respond(capnp::MessageBuilder& message, int code = 200) {
+    auto flat = capnp::messageToFlatArray(message);
+    crow::response res(code);
+    res.body.assign(reinterpret_cast<const char*>(flat.begin()), flat.asBytes().size());
+    res.set_header("Content-Type", CONTENT_TYPE);
+    res.add_header("Vary", "Accept");
+    return res;
+  }
+};
+
+#endif //CAPNP_BODY_HPP_
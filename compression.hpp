@@ -0,0 +1,217 @@
+//
+// Created by craig on 17/10/2026.
+//
+
+#ifndef COMPRESSION_HPP_
+#define COMPRESSION_HPP_
+
+#include <memory>
+#include <string>
+#include <string_view>
+#include <zlib.h>
+#ifdef CE_REST_API_BROTLI
+#include <brotli/encode.h>
+#endif
+#ifdef CE_REST_API_ZSTD
+#include <zstd.h>
+#endif
+#include "http_headers.hpp"
+
+// gzip/deflate/brotli/zstd encoders. gzip() and brotli() compress hard, for
+// content that is compressed once and served many times; compress() is for
+// per-response use and reuses one encoder context per thread.
+struct Compression {
+  enum class Encoding {
+    IDENTITY,
+    DEFLATE,
+    GZIP,
+    BROTLI,
+    ZSTD,
+  };
+
+  static const char* encodingName(Encoding encoding) {
+    switch (encoding) {
+      case Encoding::DEFLATE: return "deflate";
+      case Encoding::GZIP: return "gzip";
+      case Encoding::BROTLI: return "br";
+      case Encoding::ZSTD: return "zstd";
+      default: return "identity";
+    }
+  }
+
+  // The best encoding an Accept-Encoding header allows that this build
+  // supports. "*" stands for codings not named, and q=0 refuses a coding;
+  // other weights are not compared, the server's preference wins.
+  static Encoding negotiate(const std::string& acceptEncoding) {
+    int weights[5] = {-1, -1, -1, -1, -1};  // by Encoding; -1 when not named
+    int any = -1;
+    HttpHeaders::forEachElement(acceptEncoding, [&](std::string_view coding, std::string_view params) {
+      if (coding == "*") {
+        any = HttpHeaders::quality(params);
+      } else {
+        weights[static_cast<int>(parseCoding(coding))] = HttpHeaders::quality(params);
+      }
+    });
+    Encoding best = Encoding::IDENTITY;
+    for (auto encoding : {Encoding::DEFLATE, Encoding::GZIP, Encoding::BROTLI, Encoding::ZSTD}) {
+      int weight = weights[static_cast<int>(encoding)];
+      if (parseCoding(encodingName(encoding)) == encoding && (weight < 0 ? any : weight) > 0) {
+        best = encoding;
+      }
+    }
+    return best;
+  }
+
+  // The strong ETag of the `encoding` form of a representation whose
+  // identity ETag is `etag`: "<opaque>-<coding>". Weak tags may be shared
+  // between encodings and are returned as they are.
+  static std::string encodedETag(const std::string& etag, Encoding encoding) {
+    if (encoding == Encoding::IDENTITY || etag.size() < 2 || etag.compare(0, 2, "W/") == 0 || etag.back() != '"') {
+      return etag;
+    }
+    return etag.substr(0, etag.size() - 1) + "-" + encodingName(encoding) + "\"";
+  }
+
+  // The identity ETag an encodedETag() was made from, or an empty string if
+  // `etag` is not one.
+  static std::string identityETag(std::string_view etag) {
+    if (etag.size() < 2 || etag.front() != '"' || etag.back() != '"') {
+      return std::string();
+    }
+    auto dash = etag.rfind('-');
+    if (dash == std::string_view::npos || dash == 0 ||
+        parseCoding(etag.substr(dash + 1, etag.size() - dash - 2)) == Encoding::IDENTITY) {
+      return std::string();
+    }
+    return std::string(etag.substr(0, dash)) + "\"";
+  }
+
+  // Compresses `in` into `out` for a response. `out` keeps its capacity
+  // between calls, so a thread that reuses it stops allocating once it has
+  // seen its largest response.
+  static bool compress(Encoding encoding, const std::string& in, std::string& out) {
+    switch (encoding) {
+      case Encoding::DEFLATE:
+        return deflateWith(zlibContext(15), in, out);
+      case Encoding::GZIP:
+        return deflateWith(zlibContext(15 + 16), in, out);
+#ifdef CE_REST_API_BROTLI
+      case Encoding::BROTLI: {
+        // The one-shot brotli API keeps no state between calls.
+        out.resize(BrotliEncoderMaxCompressedSize(in.size()));
+        size_t size = out.size();
+        if (out.empty() ||
+            !BrotliEncoderCompress(5, BROTLI_DEFAULT_WINDOW, BROTLI_MODE_TEXT, in.size(),
+                                   reinterpret_cast<const uint8_t*>(in.data()), &size,
+                                   reinterpret_cast<uint8_t*>(&out[0]))) {
+          return false;
+        }
+        out.resize(size);
+        return true;
+      }
+#endif
+#ifdef CE_REST_API_ZSTD
+      case Encoding::ZSTD: {
+        thread_local std::unique_ptr<ZSTD_CCtx, size_t (*)(ZSTD_CCtx*)> context(ZSTD_createCCtx(), ZSTD_freeCCtx);
+        out.resize(ZSTD_compressBound(in.size()));
+        size_t size = ZSTD_compressCCtx(context.get(), &out[0], out.size(), in.data(), in.size(), 3);
+        if (ZSTD_isError(size)) {
+          return false;
+        }
+        out.resize(size);
+        return true;
+      }
+#endif
+      default:
+        return false;
+    }
+  }
+
+  static std::string gzip(const std::string& data, int level = Z_BEST_COMPRESSION) {
+    z_stream stream{};
+    if (deflateInit2(&stream, level, Z_DEFLATED, 15 + 16, 9, Z_DEFAULT_STRATEGY) != Z_OK) {
+      return std::string();
+    }
+    std::string out(deflateBound(&stream, data.size()), '\0');
+    stream.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(data.data()));
+    stream.avail_in = data.size();
+    stream.next_out = reinterpret_cast<Bytef*>(&out[0]);
+    stream.avail_out = out.size();
+    int result = deflate(&stream, Z_FINISH);
+    out.resize(stream.total_out);
+    deflateEnd(&stream);
+    return result == Z_STREAM_END ? out : std::string();
+  }
+
+  // Empty when the server was built without brotli.
+  static std::string brotli(const std::string& data) {
+#ifdef CE_REST_API_BROTLI
+    std::string out(BrotliEncoderMaxCompressedSize(data.size()), '\0');
+    size_t size = out.size();
+    if (out.empty() ||
+        !BrotliEncoderCompress(BROTLI_MAX_QUALITY, BROTLI_DEFAULT_WINDOW, BROTLI_MODE_TEXT, data.size(),
+                               reinterpret_cast<const uint8_t*>(data.data()), &size,
+                               reinterpret_cast<uint8_t*>(&out[0]))) {
+      return std::string();
+    }
+    out.resize(size);
+    return out;
+#else
+    (void) data;
+    return std::string();
+#endif
+  }
+
+ private:
+  struct ZlibContext {
+    explicit ZlibContext(int windowBits) {
+      ready = deflateInit2(&stream, Z_DEFAULT_COMPRESSION, Z_DEFLATED, windowBits, 8, Z_DEFAULT_STRATEGY) == Z_OK;
+    }
+
+    ~ZlibContext() {
+      if (ready) {
+        deflateEnd(&stream);
+      }
+    }
+
+    z_stream stream{};
+    bool ready = false;
+  };
+
+  // This thread's deflate stream for a zlib windowBits value (15 for
+  // deflate, 31 for gzip).
+  static ZlibContext& zlibContext(int windowBits) {
+    thread_local ZlibContext deflate(15);
+    thread_local ZlibContext gzip(15 + 16);
+    return windowBits == 15 ? deflate : gzip;
+  }
+
+  static bool deflateWith(ZlibContext& context, const std::string& in, std::string& out) {
+    if (!context.ready || deflateReset(&context.stream) != Z_OK) {
+      return false;
+    }
+    auto& stream = context.stream;
+    out.resize(deflateBound(&stream, in.size()));
+    stream.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(in.data()));
+    stream.avail_in = in.size();
+    stream.next_out = reinterpret_cast<Bytef*>(&out[0]);
+    stream.avail_out = out.size();
+    int result = deflate(&stream, Z_FINISH);
+    out.resize(stream.total_out);
+    return result == Z_STREAM_END;
+  }
+
+  static Encoding parseCoding(std::string_view coding) {
+    if (coding == "gzip" || coding == "x-gzip") return Encoding::GZIP;
+    if (coding == "deflate") return Encoding::DEFLATE;
+#ifdef CE_REST_API_BROTLI
+    if (coding == "br") return Encoding::BROTLI;
+#endif
+#ifdef CE_REST_API_ZSTD
+    if (coding == "zstd") return Encoding::ZSTD;
+#endif
+    return Encoding::IDENTITY;
+  }
+};
+
+#endif //COMPRESSION_HPP_
@@ -5,15 +5,21 @@
 #ifndef EDGE_ROUTES_HPP_
 #define EDGE_ROUTES_HPP_
 
+#include <optional>
 #include "crow.h"
+#include "rest_app.hpp"
+#include "capnp_body.hpp"
+#include "json_body_parser.hpp"
 #include "engine_service.hpp"
 #include "open_api_builder.hpp"
+#include "node_snapshot_cache.hpp"
 
 class EdgeRoutes {
  public:
-  static void registerRoutes(crow::App<crow::CORSHandler>& app, EngineService& engineService, OpenAPIBuilder& apiBuilder) {
+  static void registerRoutes(RestApp& app, EngineService& engineService,
+                             NodeSnapshotCache& snapshots, OpenAPIBuilder& apiBuilder) {
     setupSwaggerDocs(apiBuilder);
-    setupRoutes(app, engineService);
+    setupRoutes(app, engineService, snapshots);
   }
 
  private:
@@ -72,30 +78,42 @@ class EdgeRoutes {
     );
   }
 
-    static void setupRoutes(crow::App<crow::CORSHandler> &app, EngineService &engineService) {
+    static void setupRoutes(RestApp &app, EngineService &engineService,
+                            NodeSnapshotCache &snapshots) {
       CROW_ROUTE(app, "/api/edges")
           .methods("POST"_method)
-              ([&engineService](const crow::request &req) {
-                auto x = crow::json::load(req.body);
-                if (!x)
-                  return crow::response(400, "Invalid JSON");
-
+              ([&engineService, &snapshots](const crow::request &req) {
                 try {
-                  auto result = engineService.AddEdge(
-                      x["fromInstanceId"].u(),
-                      x["toInstanceId"].u(),
-                      x["outName"].s(),
-                      x["inName"].s()
-                  );
+                  std::string invalid;
+                  EngineService::EdgeResult result{};
+                  auto error = CapnpBody::readOrParse<EdgeMessage>(req, JsonBodyParser::edge, [&](EdgeMessage::Reader edge) {
+                    invalid = snapshots.checkIO(edge.getFromInstanceId(), edge.getOutName().cStr(), false);
+                    if (invalid.empty())
+                      invalid = snapshots.checkIO(edge.getToInstanceId(), edge.getInName().cStr(), true);
+                    if (invalid.empty())
+                      result = engineService.AddEdge(edge);
+                  });
+                  if (error)
+                    return std::move(*error);
+                  if (!invalid.empty())
+                    return crow::response(400, invalid);
+                  snapshots.invalidate();
 
                   uint32_t edge_id = result.edge_id;
                   bool is_data_only = result.data_only;
 
+                  if (CapnpBody::accepted(req)) {
+                    return CapnpBody::build<Engine::AddEdgeResults>([&](Engine::AddEdgeResults::Builder results) {
+                      results.setEdgeId(edge_id);
+                      results.setDataOnly(is_data_only);
+                    });
+                  }
+
                   crow::json::wvalue response;
                   response["edgeId"] = edge_id;
                   response["dataOnly"] = is_data_only;
 
-                  return crow::response(response);
+                  return CapnpBody::json(response);
                 } catch (const std::exception &e) {
                   return crow::response(500, e.what());
                 }
@@ -103,14 +121,21 @@ class EdgeRoutes {
 
       CROW_ROUTE(app, "/api/edges/<uint>")
           .methods("DELETE"_method)
-              ([&engineService](uint32_t edge_id) {
+              ([&engineService, &snapshots](const crow::request &req, uint32_t edge_id) {
                 try {
                   auto removed_edge_id = engineService.RemoveEdge(edge_id);
+                  snapshots.invalidate();
+
+                  if (CapnpBody::accepted(req)) {
+                    return CapnpBody::build<Engine::RemoveEdgeResults>([&](Engine::RemoveEdgeResults::Builder results) {
+                      results.setEdgeId(removed_edge_id);
+                    });
+                  }
 
                   crow::json::wvalue response;
                   response["edgeId"] = removed_edge_id;
 
-                  return crow::response(response);
+                  return CapnpBody::json(response);
                 } catch (const std::exception &e) {
                   return crow::response(500, e.what());
                 }
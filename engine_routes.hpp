@@ -7,14 +7,17 @@
 
 
 #include "crow.h"
-#include "engine_service.hpp"
+#include "rest_app.hpp"
+#include "capnp_body.hpp"
+#include "flow_cache.hpp"
+#include "http_headers.hpp"
 #include "open_api_builder.hpp"
 
 class EngineRoutes {
  public:
-  static void registerRoutes(crow::App<crow::CORSHandler>& app, EngineService& engineService, OpenAPIBuilder& apiBuilder) {
+  static void registerRoutes(RestApp& app, FlowCache& flowCache, OpenAPIBuilder& apiBuilder) {
     setupSwaggerDocs(apiBuilder);
-    setupRoutes(app, engineService);
+    setupRoutes(app, flowCache);
   }
 
  private:
@@ -39,20 +42,30 @@ class EngineRoutes {
   }
 
 
-  static void setupRoutes(crow::App<crow::CORSHandler>& app, EngineService& engineService) {
+  static void setupRoutes(RestApp& app, FlowCache& flowCache) {
     CROW_ROUTE(app, "/api/flow")
         .methods("GET"_method)
-            ([&engineService]() {
+            ([&flowCache](const crow::request& req) {
               try {
-                std::string jsonData = engineService.GetFlowJson();
-
-                // Since the response is already JSON text, we need to parse it
-                auto parsedJson = crow::json::load(jsonData);
-                if (!parsedJson) {
-                  return crow::response(500, "Invalid JSON received from engine");
+                // The engine's JSON is sent as-is; it is not parsed here.
+                auto flow = flowCache.get();
+                bool binary = CapnpBody::accepted(req);
+                auto etag = binary ? CapnpBody::etag(flow->etag) : flow->etag;
+                crow::response res;
+                if (HttpHeaders::noneMatch(req.get_header_value("If-None-Match"), etag)) {
+                  res.code = 304;
+                  res.add_header("Vary", "Accept");
+                } else if (binary) {
+                  res = CapnpBody::build<Engine::GetFlowJsonResults>([&](Engine::GetFlowJsonResults::Builder results) {
+                    results.setJsonData(flow->json);
+                  });
+                } else {
+                  res.body = flow->json;
+                  res.set_header("Content-Type", "application/json");
+                  res.add_header("Vary", "Accept");
                 }
-
-                return crow::response(jsonData);
+                res.set_header("ETag", etag);
+                return res;
               } catch (const std::exception &e) {
                 return crow::response(500, e.what());
               }
@@ -4,57 +4,221 @@
 
 #ifndef ENGINE_SERVICE_HPP_
 #define ENGINE_SERVICE_HPP_
-#include <capnp/ez-rpc.h>
+#include <capnp/rpc-twoparty.h>
+#include <capnp/message.h>
+#include <kj/async-io.h>
+#include <atomic>
+#include <cstring>
+#include <future>
 #include <iostream>
+#include <map>
+#include <memory>
+#include <thread>
+#include "metrics.hpp"
 #include "schemas/package.capnp.h"
 
+// Engine response copied out of the RPC message on the loop thread, so it can
+// be read from a Crow worker after the loop has released the original.
+// Copies share one refcounted buffer; readers taken from get() stay valid for
+// as long as any copy is alive.
+//
+// The one copy is deliberate. Holding the capnp::Response instead would tie
+// its release to the loop thread (kj objects may only be destroyed there, and
+// the last holder may be a worker running after the loop has stopped), and an
+// RPC message can span several segments, while words() must be the single
+// flat segment CapnpBody::respond() frames without re-encoding.
+template <typename T>
+class EngineMessage {
+ public:
+  explicit EngineMessage(typename T::Reader reader)
+      : size_(reader.totalSize().wordCount + 1), words_(new capnp::word[size_]()) {
+    capnp::copyToUnchecked(reader, kj::arrayPtr(words_.get(), size_));
+    root_ = capnp::readMessageUnchecked<T>(words_.get());
+  }
+
+  typename T::Reader get() const {
+    return root_;
+  }
+
+  size_t sizeInBytes() const {
+    return size_ * sizeof(capnp::word);
+  }
+
+  // The message as one segment: root pointer first, then its content.
+  kj::ArrayPtr<const capnp::word> words() const {
+    return kj::arrayPtr(words_.get(), size_);
+  }
+
+ private:
+  size_t size_;
+  std::shared_ptr<capnp::word[]> words_;
+  typename T::Reader root_;
+};
+
 class EngineService {
  private:
+  // One RPC session with the engine. Shared with the connect promise so the
+  // socket outlives a connect that finishes after we've given up on it.
+  struct Connection : public kj::Refcounted {
+    kj::Own<kj::AsyncIoStream> stream;
+    kj::Own<capnp::TwoPartyClient> rpc;
+    bool lost = false;
+    kj::Promise<void> watch = nullptr;
+  };
 
+  template <typename T>
+  struct PromiseValue;
+  template <typename T>
+  struct PromiseValue<kj::Promise<T>> {
+    using type = T;
+  };
 
- public:
-  EngineService() {}
-  const char *SOCKET_PATH = "/tmp/engine-socket";
-  std::pair<uint32_t, std::string> AddNode(uint32_t package_id, uint32_t node_id,
-                                           uint32_t parent_id, uint32_t pos_x, uint32_t pos_y) {
-    capnp::EzRpcClient client(kj::str("unix:", SOCKET_PATH).cStr());
-    Engine::Client engine = client.getMain<Engine>();
+  std::thread loop_thread_;
+  const kj::Executor* executor_ = nullptr;
+  std::atomic<uint64_t> reconnects_{0};
+
+  // Everything below is owned by, and only touched on, the loop thread.
+  kj::AsyncIoProvider* io_ = nullptr;
+  kj::Own<kj::PromiseFulfiller<void>> stop_;
+  kj::Own<Connection> connection_;
+  Engine::Client engine_ = nullptr;
+
+  void runLoop(std::promise<void>& ready) {
+    try {
+      auto io = kj::setupAsyncIo();
+      auto stop = kj::newPromiseAndFulfiller<void>();
+      io_ = io.provider.get();
+      stop_ = kj::mv(stop.fulfiller);
+      executor_ = &kj::getCurrentThreadExecutor();
+      ready.set_value();
+
+      stop.promise.wait(io.waitScope);
+      engine_ = nullptr;
+      connection_ = nullptr;
+    } catch (...) {
+      if (executor_ == nullptr) {
+        ready.set_exception(std::current_exception());
+      } else {
+        std::cerr << "Engine loop stopped unexpectedly" << std::endl;
+      }
+    }
+  }
 
-    auto request = engine.addNodeRequest();
-    auto node_details = request.getNodeDetails();
-    node_details.setPackageId(package_id);
-    node_details.setNodeId(node_id);
-    node_details.setParentId(parent_id);
-    node_details.setPosX(pos_x);
-    node_details.setPosY(pos_y);
+  // Returns the bootstrap capability, starting a new connection if there is
+  // none or the last one dropped. Calls made while connecting are queued on
+  // the capability and sent once the bootstrap resolves.
+  Engine::Client& engine() {
+    if (connection_ != nullptr) {
+      if (!connection_->lost) {
+        return engine_;
+      }
+      reconnects_++;
+    }
+
+    auto conn = kj::refcounted<Connection>();
+    engine_ = io_->getNetwork().parseAddress(kj::str("unix:", SOCKET_PATH))
+        .then([](kj::Own<kj::NetworkAddress> address) {
+          return address->connect();
+        })
+        .then([conn = kj::addRef(*conn)](kj::Own<kj::AsyncIoStream> stream) mutable -> Engine::Client {
+          conn->stream = kj::mv(stream);
+          conn->rpc = kj::heap<capnp::TwoPartyClient>(*conn->stream);
+          auto& lost = conn->lost;
+          conn->watch = conn->rpc->onDisconnect().then(
+              [&lost]() { lost = true; },
+              [&lost](kj::Exception&&) { lost = true; }).eagerlyEvaluate(nullptr);
+          return conn->rpc->bootstrap().castAs<Engine>();
+        }, [conn = kj::addRef(*conn)](kj::Exception&& e) mutable -> Engine::Client {
+          conn->lost = true;
+          return Engine::Client(kj::mv(e));
+        });
+    connection_ = kj::mv(conn);
+    return engine_;
+  }
 
-    auto response = request.send().wait(client.getWaitScope());
-    return {response.getInstanceId(), response.getName().cStr()};
+ public:
+  EngineService() {
+    std::promise<void> ready;
+    auto started = ready.get_future();
+    loop_thread_ = std::thread([this, &ready]() { runLoop(ready); });
+    started.get();
   }
 
-  std::pair<uint32_t, std::string> UpdateNode(uint32_t instance_id, uint32_t pos_x, uint32_t pos_y) {
-    capnp::EzRpcClient client(kj::str("unix:", SOCKET_PATH).cStr());
-    Engine::Client engine = client.getMain<Engine>();
+  ~EngineService() {
+    executor_->executeSync([this]() { stop_->fulfill(); });
+    loop_thread_.join();
+  }
 
-    auto request = engine.updateNodeRequest();
-    auto node_details = request.getNodeDetails();
-    node_details.setInstanceId(instance_id);
-    node_details.setPosX(pos_x);
-    node_details.setPosY(pos_y);
+  EngineService(const EngineService&) = delete;
+  EngineService& operator=(const EngineService&) = delete;
 
-    auto response = request.send().wait(client.getWaitScope());
-    return {response.getInstanceId(), response.getName().cStr()};
+  const char *SOCKET_PATH = "/tmp/engine-socket";
+
+  uint64_t ReconnectCount() const {
+    return reconnects_;
   }
 
-  uint32_t removeNode(uint32_t instanceId) {
-    capnp::EzRpcClient client(kj::str("unix:", SOCKET_PATH).cStr());
-    Engine::Client engine = client.getMain<Engine>();
+  // Runs func(engine) on the loop thread and hands its promise's result back
+  // as a std::future. func builds and sends requests there; it must copy out
+  // anything it needs from the responses before its promise resolves. The
+  // time to resolution is recorded against `method`.
+  template <typename Func>
+  auto Submit(EngineMethod method, Func&& func)
+      -> std::future<typename PromiseValue<decltype(func(std::declval<Engine::Client&>()))>::type> {
+    using T = typename PromiseValue<decltype(func(std::declval<Engine::Client&>()))>::type;
+    auto result = std::make_shared<std::promise<T>>();
+    auto future = result->get_future();
+
+    auto& stats = Metrics::global().rpc(method);
+    auto start = std::chrono::steady_clock::now();
+    auto observe = [&stats, start]() {
+      stats.latency.observe(std::chrono::duration_cast<std::chrono::microseconds>(
+          std::chrono::steady_clock::now() - start).count());
+    };
 
-    auto request = engine.removeNodeRequest();
-    request.setInstanceId(instanceId);
+    executor_->executeSync([&]() {
+      auto& engine = this->engine();
+      auto onError = [result, observe, &stats, conn = kj::addRef(*connection_)](kj::Exception&& e) {
+        if (e.getType() == kj::Exception::Type::DISCONNECTED) {
+          conn->lost = true;
+        }
+        observe();
+        stats.errors.fetch_add(1, std::memory_order_relaxed);
+        result->set_exception(std::make_exception_ptr(std::runtime_error(e.getDescription().cStr())));
+      };
+
+      auto promise = kj::evalNow([&]() { return func(engine); });
+      if constexpr (std::is_void_v<T>) {
+        promise.then([result, observe]() { observe(); result->set_value(); }, kj::mv(onError))
+            .detach([](kj::Exception&&) {});
+      } else {
+        promise.then([result, observe](T&& value) { observe(); result->set_value(kj::mv(value)); }, kj::mv(onError))
+            .detach([](kj::Exception&&) {});
+      }
+    });
+    return future;
+  }
+
+  std::pair<uint32_t, std::string> AddNode(NodeDetails::Reader details) {
+    return Submit(EngineMethod::ADD_NODE, [&](Engine::Client& engine) {
+      auto request = engine.addNodeRequest();
+      request.setNodeDetails(details);
+
+      return request.send().then([](capnp::Response<Engine::AddNodeResults>&& response) {
+        return std::make_pair(response.getInstanceId(), std::string(response.getName().cStr()));
+      });
+    }).get();
+  }
 
-    auto response = request.send().wait(client.getWaitScope());
-    return response.getInstanceId();
+  uint32_t removeNode(uint32_t instanceId) {
+    return Submit(EngineMethod::REMOVE_NODE, [&](Engine::Client& engine) {
+      auto request = engine.removeNodeRequest();
+      request.setInstanceId(instanceId);
+
+      return request.send().then([](capnp::Response<Engine::RemoveNodeResults>&& response) {
+        return response.getInstanceId();
+      });
+    }).get();
   }
 
   struct EdgeResult {
@@ -62,146 +226,381 @@ class EngineService {
     bool data_only;
   };
 
-  EdgeResult AddEdge(uint32_t from_instance_id, uint32_t to_instance_id,
-                     const std::string& out_name, const std::string& in_name) {
-    capnp::EzRpcClient client(kj::str("unix:", SOCKET_PATH).cStr());
-    Engine::Client engine = client.getMain<Engine>();
-
-    auto request = engine.addEdgeRequest();
-    auto edge = request.getEdge();
-    edge.setFromInstanceId(from_instance_id);
-    edge.setToInstanceId(to_instance_id);
-    edge.setOutName(out_name);
-    edge.setInName(in_name);
-
-    auto response = request.send().wait(client.getWaitScope());
-    return EdgeResult{
-        .edge_id = response.getEdgeId(),
-        .data_only = response.getDataOnly()
-    };
+  EdgeResult AddEdge(EdgeMessage::Reader edge) {
+    return Submit(EngineMethod::ADD_EDGE, [&](Engine::Client& engine) {
+      auto request = engine.addEdgeRequest();
+      request.setEdge(edge);
+
+      return request.send().then([](capnp::Response<Engine::AddEdgeResults>&& response) {
+        return EdgeResult{
+            .edge_id = response.getEdgeId(),
+            .data_only = response.getDataOnly()
+        };
+      });
+    }).get();
   }
 
   uint32_t RemoveEdge(uint32_t edge_id) {
-    capnp::EzRpcClient client(kj::str("unix:", SOCKET_PATH).cStr());
-    Engine::Client engine = client.getMain<Engine>();
-
-    auto request = engine.removeEdgeRequest();
-    request.setEdgeId(edge_id);
-
-    auto response = request.send().wait(client.getWaitScope());
-    return response.getEdgeId();
+    return Submit(EngineMethod::REMOVE_EDGE, [&](Engine::Client& engine) {
+      auto request = engine.removeEdgeRequest();
+      request.setEdgeId(edge_id);
+
+      return request.send().then([](capnp::Response<Engine::RemoveEdgeResults>&& response) {
+        return response.getEdgeId();
+      });
+    }).get();
   }
 
-  capnp::Response<Engine::GetAllValuesResults> GetAllNodes() {
-    capnp::EzRpcClient client(kj::str("unix:", SOCKET_PATH).cStr());
-    Engine::Client engine = client.getMain<Engine>();
-
-    auto request = engine.getAllValuesRequest();
-    auto response = request.send().wait(client.getWaitScope());
-
-    return response;
+  EngineMessage<Engine::GetAllValuesResults> GetAllNodes() {
+    return Submit(EngineMethod::GET_ALL_VALUES, [&](Engine::Client& engine) {
+      return engine.getAllValuesRequest().send()
+          .then([](capnp::Response<Engine::GetAllValuesResults>&& response) {
+            EngineMessage<Engine::GetAllValuesResults> message(response);
+            Metrics::global().rpc(EngineMethod::GET_ALL_VALUES).responseBytes.observe(message.sizeInBytes());
+            return message;
+          });
+    }).get();
   }
 
-  std::vector<PackageDetails::Reader> GetAvailablePackages() {
-    capnp::EzRpcClient client(kj::str("unix:", SOCKET_PATH).cStr());
-    Engine::Client engine = client.getMain<Engine>();
-
-    auto request = engine.getAvailablePackagesRequest();
-    auto response = request.send().wait(client.getWaitScope());
-
-    auto packages = response.getAvailablePackages();
-    std::vector<PackageDetails::Reader> result;
-    result.reserve(packages.size());
-
-    for (auto package : packages) {
-      result.push_back(package);
-    }
-
-    return result;
+  // The package list; readers from getAvailablePackages() share the
+  // message's buffer rather than being copied out.
+  EngineMessage<Engine::GetAvailablePackagesResults> GetAvailablePackages() {
+    return Submit(EngineMethod::GET_AVAILABLE_PACKAGES, [&](Engine::Client& engine) {
+      return engine.getAvailablePackagesRequest().send()
+          .then([](capnp::Response<Engine::GetAvailablePackagesResults>&& response) {
+            return EngineMessage<Engine::GetAvailablePackagesResults>(response);
+          });
+    }).get();
   }
 
   std::string GetPackageJson(uint32_t packageId) {
-    capnp::EzRpcClient client(kj::str("unix:", SOCKET_PATH).cStr());
-    Engine::Client engine = client.getMain<Engine>();
+    return GetPackageJsonAsync(packageId).get();
+  }
 
-    auto request = engine.getPackageJsonRequest();
-    request.setPackageId(packageId);
+  // Sends the request without waiting, so several can be in flight at once.
+  std::future<std::string> GetPackageJsonAsync(uint32_t packageId) {
+    return Submit(EngineMethod::GET_PACKAGE_JSON, [&](Engine::Client& engine) {
+      auto request = engine.getPackageJsonRequest();
+      request.setPackageId(packageId);
 
-    auto response = request.send().wait(client.getWaitScope());
-    return response.getJsonData();
+      return request.send().then([](capnp::Response<Engine::GetPackageJsonResults>&& response) {
+        return std::string(response.getJsonData().cStr());
+      });
+    });
   }
 
 
   std::string GetFlowJson() {
-    capnp::EzRpcClient client(kj::str("unix:", SOCKET_PATH).cStr());
-    Engine::Client engine = client.getMain<Engine>();
+    return Submit(EngineMethod::GET_FLOW_JSON, [&](Engine::Client& engine) {
+      return engine.getFlowJsonRequest().send()
+          .then([](capnp::Response<Engine::GetFlowJsonResults>&& response) {
+            return std::string(response.getJsonData().cStr());
+          });
+    }).get();
+  }
 
-    auto request = engine.getFlowJsonRequest();
-    auto response = request.send().wait(client.getWaitScope());
+  // Request bodies arrive already in Cap'n Proto form, as sent or as parsed
+  // by JsonBodyParser; the IO is copied into the request as is.
+  void SetDefault(uint32_t instance_id, IO::Reader io) {
+    Submit(EngineMethod::SET_DEFAULT, [&](Engine::Client& engine) {
+      auto request = engine.setDefaultRequest();
+      request.setInstanceId(instance_id);
+      request.setDefault(io);
+      return request.send().ignoreResult();
+    }).get();
+  }
 
-    return response.getJsonData().cStr();
+  void SetOverride(uint32_t instance_id, IO::Reader io, uint32_t duration, bool active, bool input) {
+    Submit(EngineMethod::SET_OVERRIDE, [&](Engine::Client& engine) {
+      auto request = engine.setOverrideRequest();
+      request.setInstanceId(instance_id);
+      request.setDuration(duration);
+      request.setActive(active);
+      request.setInput(input);
+      request.setOverride(io);
+      return request.send().ignoreResult();
+    }).get();
   }
 
-  void SetDefault(uint32_t instance_id, const std::string& name, const crow::json::rvalue& value) {
-    capnp::EzRpcClient client(kj::str("unix:", SOCKET_PATH).cStr());
-    Engine::Client engine = client.getMain<Engine>();
+  void SetFallback(uint32_t instance_id, IO::Reader io) {
+    Submit(EngineMethod::SET_FALLBACK, [&](Engine::Client& engine) {
+      auto request = engine.setFallbackRequest();
+      request.setInstanceId(instance_id);
+      request.setFallback(io);
+      return request.send().ignoreResult();
+    }).get();
+  }
 
-    auto request = engine.setDefaultRequest();
-    request.setInstanceId(instance_id);
+  // A node in a graph batch: an existing instance ID, or the temp_id given to
+  // an addNode earlier in the same batch.
+  struct NodeRef {
+    uint32_t instance_id = 0;
+    std::string temp_id;
+  };
 
-    auto io = request.getDefault();
-    io.setName(name);
+  struct GraphOp {
+    enum class Kind { ADD_NODE, UPDATE_NODE, REMOVE_NODE, ADD_EDGE, REMOVE_EDGE };
+
+    Kind kind;
+    std::string temp_id;  // ADD_NODE
+    uint32_t package_id = 0;
+    uint32_t node_id = 0;
+    uint32_t parent_id = 0;
+    int32_t pos_x = 0;
+    int32_t pos_y = 0;
+    NodeRef node;  // UPDATE_NODE, REMOVE_NODE
+    NodeRef from;  // ADD_EDGE
+    NodeRef to;
+    std::string out_name;
+    std::string in_name;
+    uint32_t edge_id = 0;  // REMOVE_EDGE
+  };
 
-    auto flex_value = io.getValue();
-    setFlexValue(flex_value, value);
+  struct GraphOpResult {
+    bool ok = false;
+    std::string error;
+    uint32_t instance_id = 0;
+    std::string name;
+    uint32_t edge_id = 0;
+    bool data_only = false;
+  };
 
-    request.send().wait(client.getWaitScope());
-  }
+  struct GraphBatchResult {
+    std::vector<GraphOpResult> results;
+    std::map<std::string, uint32_t> temp_ids;
+  };
 
-  void SetOverride(uint32_t instance_id, const std::string& name,
-                   const crow::json::rvalue& value, uint32_t duration, bool active, bool input) {
-    capnp::EzRpcClient client(kj::str("unix:", SOCKET_PATH).cStr());
-    Engine::Client engine = client.getMain<Engine>();
+ private:
+  // Loop-thread state for one ApplyGraphBatch call.
+  struct GraphBatch {
+    GraphBatch(Engine::Client engine, std::vector<GraphOp> ops)
+        : engine(kj::mv(engine)), ops(std::move(ops)), results(this->ops.size()) {}
+
+    Engine::Client engine;
+    std::vector<GraphOp> ops;
+    std::vector<GraphOpResult> results;
+    std::map<std::string, uint32_t> temp_ids;
+    std::map<std::string, int> in_flight;  // addNodes awaiting a reply, by temp_id
+
+    // Sends ops from `start` until one needs an in-flight temp_id, then waits
+    // for everything sent so far and carries on from that op.
+    kj::Promise<void> run(size_t start) {
+      kj::Vector<kj::Promise<void>> sent;
+      for (size_t i = start; i < ops.size(); i++) {
+        if (waitsOnTemp(ops[i]) && !sent.empty()) {
+          return kj::joinPromises(sent.releaseAsArray()).then([this, i]() { return run(i); });
+        }
+        sent.add(send(i));
+      }
+      return kj::joinPromises(sent.releaseAsArray());
+    }
 
-    auto request = engine.setOverrideRequest();
-    request.setInstanceId(instance_id);
-    request.setDuration(duration);
-    request.setActive(active);
-    request.setInput(input);
+    bool waitsOnTemp(const GraphOp& op) const {
+      auto pending = [this](const NodeRef& ref) {
+        return !ref.temp_id.empty() && in_flight.count(ref.temp_id) > 0;
+      };
+      return pending(op.node) || pending(op.from) || pending(op.to);
+    }
 
-    auto io = request.getOverride();
-    io.setName(name);
+    // Fills in the instance ID for a temp_id reference. Returns false and
+    // records the error if the temp_id is unknown or its addNode failed.
+    bool resolve(NodeRef& ref, GraphOpResult& result) {
+      if (ref.temp_id.empty()) {
+        return true;
+      }
+      auto found = temp_ids.find(ref.temp_id);
+      if (found == temp_ids.end()) {
+        result.error = "Unresolved temp_id '" + ref.temp_id + "'";
+        return false;
+      }
+      ref.instance_id = found->second;
+      return true;
+    }
 
-    auto flex_value = io.getValue();
-    setFlexValue(flex_value, value);
+    kj::Promise<void> send(size_t i) {
+      auto& op = ops[i];
+      auto& result = results[i];
+      auto onError = [&result](kj::Exception&& e) {
+        result.error = e.getDescription().cStr();
+      };
+
+      switch (op.kind) {
+        case GraphOp::Kind::ADD_NODE: {
+          auto request = engine.addNodeRequest();
+          auto node_details = request.getNodeDetails();
+          node_details.setPackageId(op.package_id);
+          node_details.setNodeId(op.node_id);
+          node_details.setParentId(op.parent_id);
+          node_details.setPosX(op.pos_x);
+          node_details.setPosY(op.pos_y);
+          if (!op.temp_id.empty()) {
+            in_flight[op.temp_id]++;
+          }
+          return request.send().then([this, &op, &result](capnp::Response<Engine::AddNodeResults>&& response) {
+            result.ok = true;
+            result.instance_id = response.getInstanceId();
+            result.name = response.getName().cStr();
+            if (!op.temp_id.empty()) {
+              temp_ids[op.temp_id] = result.instance_id;
+            }
+          }, kj::mv(onError)).then([this, &op]() {
+            auto found = in_flight.find(op.temp_id);
+            if (found != in_flight.end() && --found->second == 0) {
+              in_flight.erase(found);
+            }
+          });
+        }
+        case GraphOp::Kind::UPDATE_NODE: {
+          if (!resolve(op.node, result)) {
+            return kj::READY_NOW;
+          }
+          auto request = engine.updateNodeRequest();
+          auto node_details = request.getNodeDetails();
+          node_details.setInstanceId(op.node.instance_id);
+          node_details.setPosX(op.pos_x);
+          node_details.setPosY(op.pos_y);
+          return request.send().then([&result](capnp::Response<Engine::UpdateNodeResults>&& response) {
+            result.ok = true;
+            result.instance_id = response.getInstanceId();
+            result.name = response.getName().cStr();
+          }, kj::mv(onError));
+        }
+        case GraphOp::Kind::REMOVE_NODE: {
+          if (!resolve(op.node, result)) {
+            return kj::READY_NOW;
+          }
+          auto request = engine.removeNodeRequest();
+          request.setInstanceId(op.node.instance_id);
+          return request.send().then([&result](capnp::Response<Engine::RemoveNodeResults>&& response) {
+            result.ok = true;
+            result.instance_id = response.getInstanceId();
+          }, kj::mv(onError));
+        }
+        case GraphOp::Kind::ADD_EDGE: {
+          if (!resolve(op.from, result) || !resolve(op.to, result)) {
+            return kj::READY_NOW;
+          }
+          auto request = engine.addEdgeRequest();
+          auto edge = request.getEdge();
+          edge.setFromInstanceId(op.from.instance_id);
+          edge.setToInstanceId(op.to.instance_id);
+          edge.setOutName(op.out_name);
+          edge.setInName(op.in_name);
+          return request.send().then([&result](capnp::Response<Engine::AddEdgeResults>&& response) {
+            result.ok = true;
+            result.edge_id = response.getEdgeId();
+            result.data_only = response.getDataOnly();
+          }, kj::mv(onError));
+        }
+        case GraphOp::Kind::REMOVE_EDGE: {
+          auto request = engine.removeEdgeRequest();
+          request.setEdgeId(op.edge_id);
+          return request.send().then([&result](capnp::Response<Engine::RemoveEdgeResults>&& response) {
+            result.ok = true;
+            result.edge_id = response.getEdgeId();
+          }, kj::mv(onError));
+        }
+      }
+      return kj::READY_NOW;
+    }
+  };
 
-    request.send().wait(client.getWaitScope());
+ public:
+  // Applies ops in order on the shared connection. Ops are sent back to back
+  // without waiting for replies; the batch only pauses where an op names a
+  // temp_id whose addNode is still in flight. Each op succeeds or fails on
+  // its own.
+  GraphBatchResult ApplyGraphBatch(std::vector<GraphOp> ops) {
+    return Submit(EngineMethod::GRAPH_BATCH, [&](Engine::Client& engine) {
+      auto batch = kj::heap<GraphBatch>(engine, kj::mv(ops));
+      auto& ref = *batch;
+      return ref.run(0).then([&ref]() {
+        return GraphBatchResult{std::move(ref.results), std::move(ref.temp_ids)};
+      }).attach(kj::mv(batch));
+    }).get();
   }
 
-  void SetFallback(uint32_t instance_id, const std::string& name, const crow::json::rvalue& value) {
-    capnp::EzRpcClient client(kj::str("unix:", SOCKET_PATH).cStr());
-    Engine::Client engine = client.getMain<Engine>();
-
-    auto request = engine.setFallbackRequest();
-    request.setInstanceId(instance_id);
+  // One default, override or fallback write in a value batch.
+  struct ValueWrite {
+    enum class Kind { DEFAULT, OVERRIDE, FALLBACK };
+
+    Kind kind;
+    uint32_t instance_id = 0;
+    std::string name;
+    crow::json::rvalue value;
+    uint32_t duration = 0;  // OVERRIDE
+    bool active = false;
+    bool input = false;
+  };
 
-    auto io = request.getFallback();
-    io.setName(name);
+  struct ValueWriteResult {
+    bool ok = false;
+    std::string error;
+  };
 
-    auto flex_value = io.getValue();
-    setFlexValue(flex_value, value);
+  // Sends every write back to back on the shared connection and waits for
+  // all the replies together, so a batch costs about one round trip. The
+  // writes are independent: each succeeds or fails on its own.
+  std::vector<ValueWriteResult> ApplyValueBatch(const std::vector<ValueWrite>& writes) {
+    std::vector<ValueWriteResult> results(writes.size());
+    Submit(EngineMethod::VALUE_BATCH, [&](Engine::Client& engine) {
+      auto sent = kj::heapArrayBuilder<kj::Promise<void>>(writes.size());
+      for (size_t i = 0; i < writes.size(); i++) {
+        sent.add(sendValueWrite(engine, writes[i]).then([&results, i]() {
+          results[i].ok = true;
+        }, [&results, i](kj::Exception&& e) {
+          results[i].error = e.getDescription().cStr();
+        }));
+      }
+      return kj::joinPromises(sent.finish());
+    }).get();
+    return results;
+  }
 
-    request.send().wait(client.getWaitScope());
+ private:
+  static kj::Promise<void> sendValueWrite(Engine::Client& engine, const ValueWrite& write) {
+    switch (write.kind) {
+      case ValueWrite::Kind::DEFAULT: {
+        auto request = engine.setDefaultRequest();
+        request.setInstanceId(write.instance_id);
+        auto io = request.getDefault();
+        io.setName(write.name);
+        setFlexValue(io.getValue(), write.value);
+        return request.send().ignoreResult();
+      }
+      case ValueWrite::Kind::OVERRIDE: {
+        auto request = engine.setOverrideRequest();
+        request.setInstanceId(write.instance_id);
+        request.setDuration(write.duration);
+        request.setActive(write.active);
+        request.setInput(write.input);
+        auto io = request.getOverride();
+        io.setName(write.name);
+        setFlexValue(io.getValue(), write.value);
+        return request.send().ignoreResult();
+      }
+      case ValueWrite::Kind::FALLBACK: {
+        auto request = engine.setFallbackRequest();
+        request.setInstanceId(write.instance_id);
+        auto io = request.getFallback();
+        io.setName(write.name);
+        setFlexValue(io.getValue(), write.value);
+        return request.send().ignoreResult();
+      }
+    }
+    return kj::READY_NOW;
   }
 
-  void setFlexValue(FlexValueCap::Builder flex_value, const crow::json::rvalue& value) {
+ public:
+  static void setFlexValue(FlexValueCap::Builder flex_value, const crow::json::rvalue& value) {
     if (value.t() == crow::json::type::Number) {
-      if (value.d() == std::floor(value.d())) {
-        // Integer value
-        if (value.i() >= 0) {
-          flex_value.setUintVal(value.u());
+      double d = value.d();
+      if (d == std::floor(d) && d >= INT32_MIN && d <= UINT32_MAX) {
+        // Integer value that fits the 32-bit fields
+        if (d >= 0) {
+          flex_value.setUintVal(static_cast<uint32_t>(d));
         } else {
-          flex_value.setIntVal(value.i());
+          flex_value.setIntVal(static_cast<int32_t>(d));
         }
       } else {
         // Double value
@@ -0,0 +1,95 @@
+//
+// Created by craig on 17/10/2026.
+//
+
+#ifndef FLOW_CACHE_HPP_
+#define FLOW_CACHE_HPP_
+
+#include <chrono>
+#include <future>
+#include <memory>
+#include <mutex>
+#include "engine_service.hpp"
+#include "http_headers.hpp"
+#include "node_snapshot_cache.hpp"
+
+// The engine's flow JSON, passed through as the engine sent it. It is
+// reused until a write through this API bumps the snapshot revision or it
+// is older than maxAge, which bounds staleness from edits made by other
+// engine clients. Concurrent misses for one revision share a single fetch.
+class FlowCache {
+ public:
+  struct Flow {
+    std::string json;
+    std::string etag;  // strong, quoted
+    uint64_t revision = 0;
+    std::chrono::steady_clock::time_point taken;
+  };
+
+  FlowCache(EngineService& engineService, NodeSnapshotCache& snapshots, std::chrono::milliseconds maxAge)
+      : engineService(engineService), snapshots(snapshots), maxAge(maxAge) {}
+
+  std::shared_ptr<const Flow> get() {
+    uint64_t revision = snapshots.revision();
+    auto now = std::chrono::steady_clock::now();
+    std::unique_lock<std::mutex> lock(mutex);
+    if (current && current->revision == revision && now - current->taken < maxAge) {
+      return current;
+    }
+    // A fetch under way for this revision, not yet maxAge old, gives what a
+    // new one would.
+    if (pending.valid() && pendingRevision == revision && now - pendingStarted < maxAge) {
+      auto fetch = pending;
+      lock.unlock();
+      return fetch.get();
+    }
+
+    std::promise<std::shared_ptr<const Flow>> result;
+    pending = result.get_future().share();
+    pendingRevision = revision;
+    pendingStarted = now;
+    auto fetch = pending;
+    lock.unlock();
+
+    try {
+      auto flow = std::make_shared<Flow>();
+      flow->revision = revision;
+      flow->taken = now;  // aged from the request, not the reply
+      flow->json = engineService.GetFlowJson();
+
+      flow->etag = HttpHeaders::strongETag(flow->json);
+
+      lock.lock();
+      // A fetch started later saw the same or a newer revision.
+      if (!current || current->taken < flow->taken) {
+        current = flow;
+      }
+      if (pendingRevision == revision && pendingStarted == now) {
+        pending = {};
+      }
+      lock.unlock();
+      result.set_value(std::move(flow));
+    } catch (...) {
+      lock.lock();
+      if (pendingRevision == revision && pendingStarted == now) {
+        pending = {};
+      }
+      lock.unlock();
+      result.set_exception(std::current_exception());
+    }
+    return fetch.get();
+  }
+
+ private:
+  EngineService& engineService;
+  NodeSnapshotCache& snapshots;
+  const std::chrono::milliseconds maxAge;
+
+  std::mutex mutex;
+  std::shared_ptr<const Flow> current;
+  std::shared_future<std::shared_ptr<const Flow>> pending;
+  uint64_t pendingRevision = 0;  // revision the pending fetch started at
+  std::chrono::steady_clock::time_point pendingStarted;
+};
+
+#endif //FLOW_CACHE_HPP_
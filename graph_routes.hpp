@@ -0,0 +1,253 @@
+//
+// Created by craig on 17/10/2026.
+//
+
+#ifndef GRAPH_ROUTES_HPP_
+#define GRAPH_ROUTES_HPP_
+
+#include <set>
+#include <string>
+#include "crow.h"
+#include "rest_app.hpp"
+#include "engine_service.hpp"
+#include "json_body_parser.hpp"
+#include "node_snapshot_cache.hpp"
+#include "open_api_builder.hpp"
+#include "position_coalescer.hpp"
+
+class GraphRoutes {
+ public:
+  static void registerRoutes(RestApp& app, EngineService& engineService,
+                             NodeSnapshotCache& snapshots, PositionCoalescer& positions,
+                             OpenAPIBuilder& apiBuilder) {
+    setupSwaggerDocs(apiBuilder);
+    setupRoutes(app, engineService, snapshots, positions);
+  }
+
+ private:
+  static void setupSwaggerDocs(OpenAPIBuilder& apiBuilder) {
+    auto nodeRefSchema = [](const std::string& description) {
+      crow::json::wvalue schema;
+      schema["description"] = description;
+      schema["oneOf"][0]["type"] = "integer";
+      schema["oneOf"][1]["type"] = "string";
+      return schema;
+    };
+
+    auto opSchema = OpenAPIBuilder::createObjectSchema({
+                                                           {"op", "string"},
+                                                           {"tempId", "string"},
+                                                           {"packageId", "integer"},
+                                                           {"nodeId", "integer"},
+                                                           {"parentId", "integer"},
+                                                           {"posX", "integer"},
+                                                           {"posY", "integer"},
+                                                           {"outName", "string"},
+                                                           {"inName", "string"},
+                                                           {"edgeId", "integer"}
+                                                       });
+    auto& kinds = opSchema["properties"]["op"]["enum"];
+    kinds[0] = "addNode";
+    kinds[1] = "updateNode";
+    kinds[2] = "removeNode";
+    kinds[3] = "addEdge";
+    kinds[4] = "removeEdge";
+    opSchema["properties"]["tempId"]["description"] = "addNode only: a name for the new node, unique within the batch";
+    opSchema["properties"]["instanceId"] = nodeRefSchema("Instance ID, or the tempId of an addNode earlier in the batch");
+    opSchema["properties"]["fromInstanceId"] = nodeRefSchema("Instance ID or tempId");
+    opSchema["properties"]["toInstanceId"] = nodeRefSchema("Instance ID or tempId");
+
+    crow::json::wvalue batchSchema;
+    batchSchema["type"] = "object";
+    batchSchema["properties"]["ops"]["type"] = "array";
+    batchSchema["properties"]["ops"]["items"] = std::move(opSchema);
+
+    auto resultSchema = OpenAPIBuilder::createObjectSchema({
+                                                               {"ok", "boolean"},
+                                                               {"error", "string"},
+                                                               {"instanceId", "integer"},
+                                                               {"name", "string"},
+                                                               {"edgeId", "integer"},
+                                                               {"dataOnly", "boolean"}
+                                                           });
+
+    apiBuilder.addEndpoint(
+        "/api/graph/batch",
+        "POST",
+        "Apply an ordered list of node and edge changes",
+        std::move(batchSchema),
+        {{"200", {
+            {"description", "Per-op results, in request order, and the instance IDs assigned to each tempId"},
+            {"content", {
+                {"application/json", {
+                    {"schema", {
+                        {"type", "object"},
+                        {"properties", {
+                            {"results", {
+                                {"type", "array"},
+                                {"items", resultSchema}
+                            }},
+                            {"tempIds", {
+                                {"type", "object"},
+                                {"additionalProperties", {{"type", "integer"}}}
+                            }}
+                        }}
+                    }}
+                }}
+            }}
+        }}}
+    );
+  }
+
+  // Reads an instance ID or a tempId into ref. Returns an empty string on
+  // success, otherwise what is wrong with it.
+  static std::string parseNodeRef(const crow::json::rvalue& op, const char* key, EngineService::NodeRef& ref) {
+    auto& value = op[key];
+    if (value.t() == crow::json::type::String) {
+      ref.temp_id = value.s();
+      if (!ref.temp_id.empty())
+        return std::string();
+    } else if (value.t() == crow::json::type::Number) {
+      return JsonBodyParser::uint32Field(op, key, ref.instance_id);
+    }
+    return "'" + std::string(key) + "' must be an instance ID or a tempId";
+  }
+
+  // Returns an empty string on success, otherwise what is wrong with the op.
+  static std::string parseOp(const crow::json::rvalue& x, EngineService::GraphOp& op) {
+    if (x.t() != crow::json::type::Object || !x.has("op"))
+      return "missing 'op'";
+
+    std::string kind = x["op"].s();
+    std::string error;
+    if (kind == "addNode") {
+      op.kind = EngineService::GraphOp::Kind::ADD_NODE;
+      if (!x.has("packageId") || !x.has("nodeId"))
+        return "addNode requires 'packageId' and 'nodeId'";
+      error = JsonBodyParser::uint32Field(x, "packageId", op.package_id);
+      if (error.empty())
+        error = JsonBodyParser::uint32Field(x, "nodeId", op.node_id);
+      if (error.empty() && x.has("parentId"))
+        error = JsonBodyParser::uint32Field(x, "parentId", op.parent_id);
+      if (error.empty() && x.has("posX"))
+        error = JsonBodyParser::int32Field(x, "posX", op.pos_x);
+      if (error.empty() && x.has("posY"))
+        error = JsonBodyParser::int32Field(x, "posY", op.pos_y);
+      if (x.has("tempId"))
+        op.temp_id = x["tempId"].s();
+    } else if (kind == "updateNode") {
+      op.kind = EngineService::GraphOp::Kind::UPDATE_NODE;
+      if (!x.has("instanceId") || !x.has("posX") || !x.has("posY"))
+        return "updateNode requires 'instanceId', 'posX' and 'posY'";
+      error = parseNodeRef(x, "instanceId", op.node);
+      if (error.empty())
+        error = JsonBodyParser::int32Field(x, "posX", op.pos_x);
+      if (error.empty())
+        error = JsonBodyParser::int32Field(x, "posY", op.pos_y);
+    } else if (kind == "removeNode") {
+      op.kind = EngineService::GraphOp::Kind::REMOVE_NODE;
+      if (!x.has("instanceId"))
+        return "removeNode requires 'instanceId'";
+      error = parseNodeRef(x, "instanceId", op.node);
+    } else if (kind == "addEdge") {
+      op.kind = EngineService::GraphOp::Kind::ADD_EDGE;
+      if (!x.has("fromInstanceId") || !x.has("toInstanceId") || !x.has("outName") || !x.has("inName"))
+        return "addEdge requires 'fromInstanceId', 'toInstanceId', 'outName' and 'inName'";
+      error = parseNodeRef(x, "fromInstanceId", op.from);
+      if (error.empty())
+        error = parseNodeRef(x, "toInstanceId", op.to);
+      op.out_name = x["outName"].s();
+      op.in_name = x["inName"].s();
+    } else if (kind == "removeEdge") {
+      op.kind = EngineService::GraphOp::Kind::REMOVE_EDGE;
+      if (!x.has("edgeId"))
+        return "removeEdge requires 'edgeId'";
+      error = JsonBodyParser::uint32Field(x, "edgeId", op.edge_id);
+    } else {
+      return "unknown op '" + kind + "'";
+    }
+    return error;
+  }
+
+  static void setupRoutes(RestApp& app, EngineService& engineService,
+                          NodeSnapshotCache& snapshots, PositionCoalescer& positions) {
+    CROW_ROUTE(app, "/api/graph/batch")
+        .methods("POST"_method)
+            ([&engineService, &snapshots, &positions](const crow::request& req) {
+              auto x = Metrics::global().timeJsonParse([&req]() { return crow::json::load(req.body); });
+              if (!x || !x.has("ops") || x["ops"].t() != crow::json::type::List)
+                return crow::response(400, "Invalid JSON. Required field: 'ops' (array)");
+
+              std::vector<EngineService::GraphOp> ops;
+              std::vector<EngineService::GraphOp::Kind> kinds;
+              std::set<std::string> tempIds;
+              ops.reserve(x["ops"].size());
+              for (size_t i = 0; i < x["ops"].size(); i++) {
+                EngineService::GraphOp op;
+                auto error = parseOp(x["ops"][i], op);
+                if (error.empty() && !op.temp_id.empty() && !tempIds.insert(op.temp_id).second)
+                  error = "duplicate tempId '" + op.temp_id + "'";
+                if (error.empty() && op.kind == EngineService::GraphOp::Kind::ADD_EDGE) {
+                  // Only nodes that already exist can be checked; tempId ends
+                  // are left to the engine.
+                  if (op.from.temp_id.empty())
+                    error = snapshots.checkIO(op.from.instance_id, op.out_name, false);
+                  if (error.empty() && op.to.temp_id.empty())
+                    error = snapshots.checkIO(op.to.instance_id, op.in_name, true);
+                }
+                if (!error.empty())
+                  return crow::response(400, "ops[" + std::to_string(i) + "]: " + error);
+                kinds.push_back(op.kind);
+                ops.push_back(std::move(op));
+              }
+
+              try {
+                for (auto& op : ops) {
+                  if (op.kind == EngineService::GraphOp::Kind::REMOVE_NODE && op.node.temp_id.empty())
+                    positions.drop(op.node.instance_id);
+                }
+                auto batch = engineService.ApplyGraphBatch(std::move(ops));
+                snapshots.invalidate();
+
+                crow::json::wvalue response;
+                response["results"] = crow::json::wvalue::list();
+                for (size_t i = 0; i < batch.results.size(); i++) {
+                  auto& result = batch.results[i];
+                  auto& json = response["results"][i];
+                  json["ok"] = result.ok;
+                  if (!result.ok) {
+                    json["error"] = result.error;
+                    continue;
+                  }
+                  switch (kinds[i]) {
+                    case EngineService::GraphOp::Kind::ADD_NODE:
+                    case EngineService::GraphOp::Kind::UPDATE_NODE:
+                      json["instanceId"] = result.instance_id;
+                      json["name"] = result.name;
+                      break;
+                    case EngineService::GraphOp::Kind::REMOVE_NODE:
+                      json["instanceId"] = result.instance_id;
+                      break;
+                    case EngineService::GraphOp::Kind::ADD_EDGE:
+                      json["edgeId"] = result.edge_id;
+                      json["dataOnly"] = result.data_only;
+                      break;
+                    case EngineService::GraphOp::Kind::REMOVE_EDGE:
+                      json["edgeId"] = result.edge_id;
+                      break;
+                  }
+                }
+                response["tempIds"] = crow::json::wvalue::object();
+                for (auto& [tempId, instanceId] : batch.temp_ids) {
+                  response["tempIds"][tempId] = instanceId;
+                }
+
+                return crow::response(response);
+              } catch (const std::exception& e) {
+                return crow::response(500, e.what());
+              }
+            });
+  }
+};
+
+#endif //GRAPH_ROUTES_HPP_
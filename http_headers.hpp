@@ -0,0 +1,161 @@
+//
+// Created by craig on 17/10/2026.
+//
+
+#ifndef HTTP_HEADERS_HPP_
+#define HTTP_HEADERS_HPP_
+
+#include <cstdint>
+#include <cstdio>
+#include <initializer_list>
+#include <string>
+#include <string_view>
+
+// Parsing for the list-valued request headers used in negotiation and
+// revalidation: Accept, Accept-Encoding and If-None-Match, and the ETags
+// that If-None-Match is checked against.
+struct HttpHeaders {
+  // Calls fn(value, params) for each comma-separated element of a list
+  // header, trimmed; params is what follows the first ';', if anything.
+  // Empty elements are skipped.
+  template <typename Func>
+  static void forEachElement(std::string_view header, Func&& fn) {
+    size_t pos = 0;
+    while (pos < header.size()) {
+      size_t end = header.find(',', pos);
+      if (end == std::string_view::npos) {
+        end = header.size();
+      }
+      auto item = header.substr(pos, end - pos);
+      pos = end + 1;
+
+      size_t semicolon = item.find(';');
+      auto value = trim(item.substr(0, semicolon));
+      auto params = semicolon == std::string_view::npos ? std::string_view() : item.substr(semicolon + 1);
+      if (!value.empty()) {
+        fn(value, params);
+      }
+    }
+  }
+
+  // The q weight in an element's params, in thousandths; 1000 if absent.
+  static int quality(std::string_view params) {
+    int weight = 1000;
+    forEachParam(params, [&weight](std::string_view name, std::string_view value) {
+      if (name != "q" && name != "Q") {
+        return;
+      }
+      // qvalue = ( "0" [ "." 0*3DIGIT ] ) / ( "1" [ "." 0*3("0") ] )
+      weight = 0;
+      if (value.empty() || value[0] < '0' || value[0] > '1') {
+        return;
+      }
+      weight = (value[0] - '0') * 1000;
+      int scale = 100;
+      for (size_t i = 2; i < value.size() && i < 5 && value[1] == '.'; i++) {
+        if (value[i] < '0' || value[i] > '9') {
+          break;
+        }
+        weight += (value[i] - '0') * scale;
+        scale /= 10;
+      }
+      if (weight > 1000) {
+        weight = 1000;
+      }
+    });
+    return weight;
+  }
+
+  // The index in `offered` of the media type an Accept header prefers, or -1
+  // if it accepts none of them. Each offer takes the q of the most specific
+  // range naming it (type/subtype, then type/*, then */*); the highest q
+  // wins, the earlier offer on a tie. No header accepts the first offer.
+  static int preferred(std::string_view accept, std::initializer_list<std::string_view> offered) {
+    if (trim(accept).empty()) {
+      return offered.size() > 0 ? 0 : -1;
+    }
+    int best = -1;
+    int bestWeight = 0;
+    int index = 0;
+    for (auto type : offered) {
+      int specificity = -1;
+      int weight = 0;
+      forEachElement(accept, [&](std::string_view range, std::string_view params) {
+        int rank = range == type ? 2
+            : range == "*/*" ? 0
+            : range.size() > 2 && range.substr(range.size() - 2) == "/*" &&
+                    type.substr(0, range.size() - 1) == range.substr(0, range.size() - 1) ? 1
+            : -1;
+        if (rank > specificity) {
+          specificity = rank;
+          weight = quality(params);
+        }
+      });
+      if (weight > bestWeight) {
+        best = index;
+        bestWeight = weight;
+      }
+      index++;
+    }
+    return best;
+  }
+
+  // 64-bit FNV-1a of text, continuing from seed: hash(b, hash(a)) is the
+  // hash of a followed by b.
+  static uint64_t hash(std::string_view text, uint64_t seed = 14695981039346656037ull) {
+    for (unsigned char c : text) {
+      seed = (seed ^ c) * 1099511628211ull;
+    }
+    return seed;
+  }
+
+  // A strong, quoted ETag for content: its hash() in hex.
+  static std::string strongETag(std::string_view content, uint64_t seed = 14695981039346656037ull) {
+    char buf[24];
+    snprintf(buf, sizeof(buf), "\"%016llx\"", static_cast<unsigned long long>(hash(content, seed)));
+    return buf;
+  }
+
+  // Whether an If-None-Match header matches `etag`, by the weak comparison
+  // RFC 9110 specifies for it: W/ prefixes are ignored, and * matches
+  // anything.
+  static bool noneMatch(std::string_view ifNoneMatch, std::string_view etag) {
+    auto opaque = weakless(etag);
+    bool matched = false;
+    forEachElement(ifNoneMatch, [&](std::string_view tag, std::string_view) {
+      matched = matched || tag == "*" || weakless(tag) == opaque;
+    });
+    return matched;
+  }
+
+ private:
+  static std::string_view trim(std::string_view text) {
+    size_t begin = text.find_first_not_of(" \t");
+    size_t end = text.find_last_not_of(" \t");
+    return begin == std::string_view::npos ? std::string_view() : text.substr(begin, end - begin + 1);
+  }
+
+  static std::string_view weakless(std::string_view tag) {
+    return tag.substr(0, 2) == "W/" ? tag.substr(2) : tag;
+  }
+
+  // Calls fn(name, value) for each ;-separated name=value parameter.
+  template <typename Func>
+  static void forEachParam(std::string_view params, Func&& fn) {
+    size_t pos = 0;
+    while (pos < params.size()) {
+      size_t end = params.find(';', pos);
+      if (end == std::string_view::npos) {
+        end = params.size();
+      }
+      auto param = params.substr(pos, end - pos);
+      pos = end + 1;
+      size_t equals = param.find('=');
+      if (equals != std::string_view::npos) {
+        fn(trim(param.substr(0, equals)), trim(param.substr(equals + 1)));
+      }
+    }
+  }
+};
+
+#endif //HTTP_HEADERS_HPP_
@@ -0,0 +1,85 @@
+//
+// Created by craig on 17/10/2026.
+//
+
+#ifndef IO_NAME_TABLE_HPP_
+#define IO_NAME_TABLE_HPP_
+
+#include <algorithm>
+#include <map>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+#include "schemas/package.capnp.h"
+
+// IO names of a getAllValues snapshot, interned to integer IDs. Nodes of the
+// same type have the same IO names, so each distinct set is stored once as a
+// layout of sorted IDs and nodes point at their layout. A name check is one
+// hash lookup and a binary search over a node's few IDs.
+//
+// Names are views into the snapshot's message and live as long as it does.
+class IoNameTable {
+ public:
+  static constexpr uint32_t NONE = ~0u;
+
+  void build(capnp::List<Node, capnp::Kind::STRUCT>::Reader nodes) {
+    std::map<std::vector<uint32_t>, uint32_t> seen;  // unsorted IDs, inputs then NONE then outputs
+    std::vector<uint32_t> key;
+    layoutOf.reserve(nodes.size());
+    for (auto node : nodes) {
+      key.clear();
+      for (auto io : node.getInputs()) {
+        key.push_back(intern(io.getName()));
+      }
+      key.push_back(NONE);
+      for (auto io : node.getOutputs()) {
+        key.push_back(intern(io.getName()));
+      }
+
+      auto found = seen.find(key);
+      if (found == seen.end()) {
+        auto split = std::find(key.begin(), key.end(), NONE);
+        Layout layout{std::vector<uint32_t>(key.begin(), split), std::vector<uint32_t>(split + 1, key.end())};
+        std::sort(layout.inputs.begin(), layout.inputs.end());
+        std::sort(layout.outputs.begin(), layout.outputs.end());
+        found = seen.emplace(key, layouts.size()).first;
+        layouts.push_back(std::move(layout));
+      }
+      layoutOf.push_back(found->second);
+    }
+  }
+
+  // The ID of `name`, or NONE if no node in the snapshot has an IO by it.
+  uint32_t id(std::string_view name) const {
+    auto found = ids.find(name);
+    return found == ids.end() ? NONE : found->second;
+  }
+
+  // Whether the node at position `index` in the snapshot has an input (or
+  // output) called `name`.
+  bool has(uint32_t index, std::string_view name, bool input) const {
+    uint32_t nameId = id(name);
+    if (nameId == NONE || index >= layoutOf.size()) {
+      return false;
+    }
+    auto& layout = layouts[layoutOf[index]];
+    auto& names = input ? layout.inputs : layout.outputs;
+    return std::binary_search(names.begin(), names.end(), nameId);
+  }
+
+ private:
+  struct Layout {
+    std::vector<uint32_t> inputs;
+    std::vector<uint32_t> outputs;
+  };
+
+  std::unordered_map<std::string_view, uint32_t> ids;
+  std::vector<Layout> layouts;
+  std::vector<uint32_t> layoutOf;  // parallel to the snapshot's nodes
+
+  uint32_t intern(capnp::Text::Reader name) {
+    return ids.emplace(std::string_view(name.cStr(), name.size()), ids.size()).first->second;
+  }
+};
+
+#endif //IO_NAME_TABLE_HPP_
@@ -0,0 +1,559 @@
+//
+// Created by craig on 17/10/2026.
+//
+
+#ifndef JSON_BODY_PARSER_HPP_
+#define JSON_BODY_PARSER_HPP_
+
+#include <charconv>
+#include <cmath>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include "crow.h"
+#include "schemas/package.capnp.h"
+
+// Single-pass parsers for the JSON bodies of the write routes. Each one
+// walks the body once, matches keys against the fields its shape expects and
+// writes values straight into a Cap'n Proto builder, with no intermediate
+// tree. Values must have the field's type: integers must be whole and in
+// range, booleans must be true or false. Unknown keys are checked for
+// syntax and ignored.
+//
+// Each function returns an empty string on success, otherwise a message for
+// a 400 response.
+class JsonBodyParser {
+ public:
+  // POST /api/nodes: packageId and nodeId, optional parentId, posX and posY.
+  static std::string nodeDetails(const std::string& body, NodeDetails::Builder details) {
+    JsonBodyParser parser(body);
+    uint32_t seen = 0;
+    bool ok = parser.members([&](std::string_view key) {
+      if (key == "packageId") {
+        seen |= 1;
+        return parser.read(key, details, &NodeDetails::Builder::setPackageId);
+      } else if (key == "nodeId") {
+        seen |= 2;
+        return parser.read(key, details, &NodeDetails::Builder::setNodeId);
+      } else if (key == "parentId") {
+        return parser.read(key, details, &NodeDetails::Builder::setParentId);
+      } else if (key == "posX") {
+        return parser.read(key, details, &NodeDetails::Builder::setPosX);
+      } else if (key == "posY") {
+        return parser.read(key, details, &NodeDetails::Builder::setPosY);
+      }
+      return parser.skipValue();
+    });
+    return parser.result(ok, seen, 3, "Required fields: 'packageId' and 'nodeId'");
+  }
+
+  // PUT /api/nodes: instanceId, posX and posY.
+  static std::string nodePosition(const std::string& body, NodeDetails::Builder details) {
+    JsonBodyParser parser(body);
+    uint32_t seen = 0;
+    bool ok = parser.members([&](std::string_view key) {
+      if (key == "instanceId") {
+        seen |= 1;
+        return parser.read(key, details, &NodeDetails::Builder::setInstanceId);
+      } else if (key == "posX") {
+        seen |= 2;
+        return parser.read(key, details, &NodeDetails::Builder::setPosX);
+      } else if (key == "posY") {
+        seen |= 4;
+        return parser.read(key, details, &NodeDetails::Builder::setPosY);
+      }
+      return parser.skipValue();
+    });
+    return parser.result(ok, seen, 7, "Required fields: 'instanceId', 'posX' and 'posY'");
+  }
+
+  // POST /api/edges: fromInstanceId, toInstanceId, outName and inName.
+  static std::string edge(const std::string& body, EdgeMessage::Builder edge) {
+    JsonBodyParser parser(body);
+    uint32_t seen = 0;
+    bool ok = parser.members([&](std::string_view key) {
+      if (key == "fromInstanceId") {
+        seen |= 1;
+        return parser.read(key, edge, &EdgeMessage::Builder::setFromInstanceId);
+      } else if (key == "toInstanceId") {
+        seen |= 2;
+        return parser.read(key, edge, &EdgeMessage::Builder::setToInstanceId);
+      } else if (key == "outName") {
+        seen |= 4;
+        return parser.read(key, edge, &EdgeMessage::Builder::setOutName);
+      } else if (key == "inName") {
+        seen |= 8;
+        return parser.read(key, edge, &EdgeMessage::Builder::setInName);
+      }
+      return parser.skipValue();
+    });
+    return parser.result(ok, seen, 15, "Required fields: 'fromInstanceId', 'toInstanceId', 'outName' and 'inName'");
+  }
+
+  // PUT /api/nodes/<id>/default and /fallback: name and value.
+  static std::string io(const std::string& body, IO::Builder io) {
+    JsonBodyParser parser(body);
+    uint32_t seen = 0;
+    bool ok = parser.members([&](std::string_view key) {
+      if (key == "name") {
+        seen |= 1;
+        return parser.read(key, io, &IO::Builder::setName);
+      } else if (key == "value") {
+        seen |= 2;
+        return parser.readFlexValue(key, io.getValue());
+      }
+      return parser.skipValue();
+    });
+    return parser.result(ok, seen, 3, "Required fields: 'name' and 'value'");
+  }
+
+  // PUT /api/nodes/<id>/override: name, value and duration, optional active
+  // and input.
+  static std::string override(const std::string& body, Engine::SetOverrideParams::Builder params) {
+    using Params = Engine::SetOverrideParams::Builder;
+    JsonBodyParser parser(body);
+    uint32_t seen = 0;
+    auto io = params.getOverride();
+    bool ok = parser.members([&](std::string_view key) {
+      if (key == "name") {
+        seen |= 1;
+        return parser.read(key, io, &IO::Builder::setName);
+      } else if (key == "value") {
+        seen |= 2;
+        return parser.readFlexValue(key, io.getValue());
+      } else if (key == "duration") {
+        seen |= 4;
+        return parser.read(key, params, &Params::setDuration);
+      } else if (key == "active") {
+        return parser.read(key, params, &Params::setActive);
+      } else if (key == "input") {
+        return parser.read(key, params, &Params::setInput);
+      }
+      return parser.skipValue();
+    });
+    return parser.result(ok, seen, 7, "Required fields: 'name', 'value', and 'duration'");
+  }
+
+  // The same integer rules for a field of a body the batch routes parse
+  // with crow::json, which would otherwise wrap negatives and truncate
+  // fractions. Each sets `value` and returns an empty string, or returns the
+  // message for a 400.
+  static std::string uint32Field(const crow::json::rvalue& x, const char* name, uint32_t& value) {
+    auto& field = x[name];
+    if (field.t() != crow::json::type::Number || field.nt() != crow::json::num_type::Unsigned_integer ||
+        field.u() > UINT32_MAX) {
+      return "'" + std::string(name) + "' must be an unsigned 32-bit integer";
+    }
+    value = static_cast<uint32_t>(field.u());
+    return std::string();
+  }
+
+  static std::string int32Field(const crow::json::rvalue& x, const char* name, int32_t& value) {
+    auto& field = x[name];
+    if (field.t() != crow::json::type::Number ||
+        (field.nt() != crow::json::num_type::Signed_integer && field.nt() != crow::json::num_type::Unsigned_integer) ||
+        field.i() < INT32_MIN || field.i() > INT32_MAX) {
+      return "'" + std::string(name) + "' must be a 32-bit integer";
+    }
+    value = static_cast<int32_t>(field.i());
+    return std::string();
+  }
+
+ private:
+  static constexpr int MAX_DEPTH = 64;
+
+  const char* pos;
+  const char* end;
+  std::string error;
+  std::string string;  // last string read, unescaped
+  std::string key;     // last key, when it had escapes
+
+  explicit JsonBodyParser(const std::string& body) : pos(body.data()), end(body.data() + body.size()) {}
+
+  std::string result(bool ok, uint32_t seen, uint32_t required, const char* missing) {
+    if (!ok) {
+      return error.empty() ? "Invalid JSON" : error;
+    }
+    return (seen & required) == required ? std::string() : std::string("Invalid JSON. ") + missing;
+  }
+
+  capnp::Text::Reader text() const {
+    return capnp::Text::Reader(string.c_str(), string.size());
+  }
+
+  void skipSpace() {
+    while (pos < end && (*pos == ' ' || *pos == '\t' || *pos == '\n' || *pos == '\r')) {
+      pos++;
+    }
+  }
+
+  bool consume(char c) {
+    skipSpace();
+    if (pos < end && *pos == c) {
+      pos++;
+      return true;
+    }
+    return false;
+  }
+
+  bool literal(const char* word, size_t size) {
+    if (static_cast<size_t>(end - pos) < size || std::string_view(pos, size) != std::string_view(word, size)) {
+      return false;
+    }
+    pos += size;
+    return true;
+  }
+
+  // Calls onMember(key) for each member of the top-level object, with pos at
+  // the value; onMember must consume the value. Fails on malformed JSON, on
+  // anything after the object, or when onMember fails.
+  template <typename Func>
+  bool members(Func&& onMember) {
+    if (!consume('{')) {
+      return false;
+    }
+    if (!consume('}')) {
+      do {
+        std::string_view name;
+        if (!consume('"') || !readKey(name) || !consume(':')) {
+          return false;
+        }
+        skipSpace();
+        if (!onMember(name)) {
+          return false;
+        }
+      } while (consume(','));
+      if (!consume('}')) {
+        return false;
+      }
+    }
+    skipSpace();
+    return pos == end;
+  }
+
+  // With pos just past the opening quote. Keys without escapes are viewed in
+  // place.
+  bool readKey(std::string_view& name) {
+    const char* start = pos;
+    while (pos < end && *pos != '"' && *pos != '\\' && static_cast<unsigned char>(*pos) >= 0x20) {
+      pos++;
+    }
+    if (pos < end && *pos == '"') {
+      name = std::string_view(start, pos - start);
+      pos++;
+      return true;
+    }
+    pos = start;
+    if (!readStringBody(key)) {
+      return false;
+    }
+    name = key;
+    return true;
+  }
+
+  bool readString(std::string_view name) {
+    if (pos >= end || *pos != '"') {
+      return typeError(name, "a string");
+    }
+    pos++;
+    return readStringBody(string);
+  }
+
+  // Unescapes up to the closing quote into `out`.
+  bool readStringBody(std::string& out) {
+    out.clear();
+    while (pos < end) {
+      const char* run = pos;
+      while (pos < end && *pos != '"' && *pos != '\\' && static_cast<unsigned char>(*pos) >= 0x20) {
+        pos++;
+      }
+      out.append(run, pos - run);
+      if (pos >= end || static_cast<unsigned char>(*pos) < 0x20) {
+        return false;
+      }
+      if (*pos++ == '"') {
+        return true;
+      }
+      if (pos >= end) {
+        return false;
+      }
+      switch (*pos++) {
+        case '"': out.push_back('"'); break;
+        case '\\': out.push_back('\\'); break;
+        case '/': out.push_back('/'); break;
+        case 'b': out.push_back('\b'); break;
+        case 'f': out.push_back('\f'); break;
+        case 'n': out.push_back('\n'); break;
+        case 'r': out.push_back('\r'); break;
+        case 't': out.push_back('\t'); break;
+        case 'u': {
+          uint32_t code;
+          if (!readHex4(code)) {
+            return false;
+          }
+          if (code >= 0xd800 && code < 0xdc00) {  // high surrogate; a low one must follow
+            uint32_t low;
+            if (!literal("\\u", 2) || !readHex4(low) || low < 0xdc00 || low >= 0xe000) {
+              return false;
+            }
+            code = 0x10000 + ((code - 0xd800) << 10) + (low - 0xdc00);
+          }
+          appendUtf8(out, code);
+          break;
+        }
+        default:
+          return false;
+      }
+    }
+    return false;
+  }
+
+  bool readHex4(uint32_t& code) {
+    if (end - pos < 4) {
+      return false;
+    }
+    auto result = std::from_chars(pos, pos + 4, code, 16);
+    if (result.ptr != pos + 4) {
+      return false;
+    }
+    pos += 4;
+    return true;
+  }
+
+  static void appendUtf8(std::string& out, uint32_t code) {
+    if (code < 0x80) {
+      out.push_back(static_cast<char>(code));
+    } else if (code < 0x800) {
+      out.push_back(static_cast<char>(0xc0 | (code >> 6)));
+      out.push_back(static_cast<char>(0x80 | (code & 0x3f)));
+    } else if (code < 0x10000) {
+      out.push_back(static_cast<char>(0xe0 | (code >> 12)));
+      out.push_back(static_cast<char>(0x80 | ((code >> 6) & 0x3f)));
+      out.push_back(static_cast<char>(0x80 | (code & 0x3f)));
+    } else {
+      out.push_back(static_cast<char>(0xf0 | (code >> 18)));
+      out.push_back(static_cast<char>(0x80 | ((code >> 12) & 0x3f)));
+      out.push_back(static_cast<char>(0x80 | ((code >> 6) & 0x3f)));
+      out.push_back(static_cast<char>(0x80 | (code & 0x3f)));
+    }
+  }
+
+  // A JSON number at pos: its extent, and whether it has a fraction or
+  // exponent. Returns false if pos is not at a number.
+  bool scanNumber(const char*& start, bool& integral) {
+    start = pos;
+    const char* p = pos;
+    if (p < end && *p == '-') p++;
+    if (p >= end || *p < '0' || *p > '9') return false;
+    if (*p == '0') {
+      p++;
+    } else {
+      while (p < end && *p >= '0' && *p <= '9') p++;
+    }
+    integral = true;
+    if (p < end && *p == '.') {
+      integral = false;
+      if (++p >= end || *p < '0' || *p > '9') return false;
+      while (p < end && *p >= '0' && *p <= '9') p++;
+    }
+    if (p < end && (*p == 'e' || *p == 'E')) {
+      integral = false;
+      p++;
+      if (p < end && (*p == '+' || *p == '-')) p++;
+      if (p >= end || *p < '0' || *p > '9') return false;
+      while (p < end && *p >= '0' && *p <= '9') p++;
+    }
+    pos = p;
+    return true;
+  }
+
+  // Whether from_chars took the whole number at [start, pos) and it fit.
+  bool parsed(std::from_chars_result result) const {
+    return result.ec == std::errc() && result.ptr == pos;
+  }
+
+  // Reads the value for field `name` and passes it to the builder's setter;
+  // the setter's parameter type picks the JSON type expected.
+  template <typename Builder>
+  bool read(std::string_view name, Builder& builder, void (Builder::*set)(uint32_t)) {
+    uint32_t value;
+    if (!readUint(name, value)) {
+      return false;
+    }
+    (builder.*set)(value);
+    return true;
+  }
+
+  template <typename Builder>
+  bool read(std::string_view name, Builder& builder, void (Builder::*set)(int32_t)) {
+    int32_t value;
+    if (!readInt(name, value)) {
+      return false;
+    }
+    (builder.*set)(value);
+    return true;
+  }
+
+  template <typename Builder>
+  bool read(std::string_view name, Builder& builder, void (Builder::*set)(bool)) {
+    bool value;
+    if (!readBool(name, value)) {
+      return false;
+    }
+    (builder.*set)(value);
+    return true;
+  }
+
+  template <typename Builder>
+  bool read(std::string_view name, Builder& builder, void (Builder::*set)(capnp::Text::Reader)) {
+    if (!readString(name)) {
+      return false;
+    }
+    (builder.*set)(text());
+    return true;
+  }
+
+  bool readUint(std::string_view name, uint32_t& value) {
+    const char* start;
+    bool integral;
+    if (!scanNumber(start, integral) || !integral || !parsed(std::from_chars(start, pos, value))) {
+      return typeError(name, "an unsigned 32-bit integer");
+    }
+    return true;
+  }
+
+  bool readInt(std::string_view name, int32_t& value) {
+    const char* start;
+    bool integral;
+    if (!scanNumber(start, integral) || !integral || !parsed(std::from_chars(start, pos, value))) {
+      return typeError(name, "a 32-bit integer");
+    }
+    return true;
+  }
+
+  bool readBool(std::string_view name, bool& value) {
+    if (literal("true", 4)) {
+      value = true;
+    } else if (literal("false", 5)) {
+      value = false;
+    } else {
+      return typeError(name, "true or false");
+    }
+    return true;
+  }
+
+  // Numbers, strings and booleans, typed as EngineService::setFlexValue
+  // types them: whole numbers that fit become uintVal (or intVal when
+  // negative), others doubleVal.
+  bool readFlexValue(std::string_view name, FlexValueCap::Builder value) {
+    bool flag;
+    if (pos < end && *pos == '"') {
+      pos++;
+      if (!readStringBody(string)) {
+        return false;
+      }
+      value.setStringVal(text());
+      return true;
+    }
+    if (pos < end && (*pos == 't' || *pos == 'f')) {
+      if (!readBool(name, flag)) {
+        return false;
+      }
+      value.setBoolVal(flag);
+      return true;
+    }
+
+    const char* start;
+    bool integral;
+    if (!scanNumber(start, integral)) {
+      return typeError(name, "a number, string or boolean");
+    }
+    if (integral) {
+      if (*start != '-') {
+        uint32_t u;
+        if (parsed(std::from_chars(start, pos, u))) {
+          value.setUintVal(u);
+          return true;
+        }
+      } else {
+        int32_t i;
+        if (parsed(std::from_chars(start, pos, i))) {
+          value.setIntVal(i);
+          return true;
+        }
+      }
+    }
+    // Fractions, exponents, and integers outside 32 bits.
+    double d;
+    if (!parsed(std::from_chars(start, pos, d))) {
+      return typeError(name, "a finite number");
+    }
+    if (d == std::floor(d) && d >= INT32_MIN && d <= UINT32_MAX) {
+      if (d >= 0) {
+        value.setUintVal(static_cast<uint32_t>(d));
+      } else {
+        value.setIntVal(static_cast<int32_t>(d));
+      }
+    } else {
+      value.setDoubleVal(d);
+    }
+    return true;
+  }
+
+  // Checks and steps over any value.
+  bool skipValue(int depth = 0) {
+    if (depth > MAX_DEPTH || pos >= end) {
+      return false;
+    }
+    const char* start;
+    bool integral;
+    switch (*pos) {
+      case '"':
+        pos++;
+        return readStringBody(string);
+      case 't':
+        return literal("true", 4);
+      case 'f':
+        return literal("false", 5);
+      case 'n':
+        return literal("null", 4);
+      case '[':
+        pos++;
+        if (consume(']')) {
+          return true;
+        }
+        do {
+          skipSpace();
+          if (!skipValue(depth + 1)) {
+            return false;
+          }
+        } while (consume(','));
+        return consume(']');
+      case '{':
+        pos++;
+        if (consume('}')) {
+          return true;
+        }
+        do {
+          std::string_view name;
+          if (!consume('"') || !readKey(name) || !consume(':')) {
+            return false;
+          }
+          skipSpace();
+          if (!skipValue(depth + 1)) {
+            return false;
+          }
+        } while (consume(','));
+        return consume('}');
+      default:
+        return scanNumber(start, integral);
+    }
+  }
+
+  bool typeError(std::string_view name, const char* expected) {
+    error = "'" + std::string(name) + "' must be " + expected;
+    return false;
+  }
+};
+
+#endif //JSON_BODY_PARSER_HPP_
@@ -1,4 +1,5 @@
 #include "crow.h"
+#include "rest_app.hpp"
 #include <crow/middlewares/cors.h>
 #include "open_api_builder.hpp"
 #include "swagger_ui.hpp"
@@ -7,13 +8,108 @@
 #include "edge_routes.hpp"
 #include "package_routes.hpp"
 #include "engine_routes.hpp"
+#include "graph_routes.hpp"
+#include "stream_routes.hpp"
+#include "metrics_routes.hpp"
+#include "http_headers.hpp"
+#include "static_asset_cache.hpp"
 
 const char *SOCKET_PATH = "/tmp/engine-socket";
+
+// Worker thread count, from CE_REST_API_THREADS or one per core.
+static unsigned int serverConcurrency() {
+  if (const char* env = std::getenv("CE_REST_API_THREADS")) {
+    int threads = std::atoi(env);
+    if (threads > 0) {
+      return static_cast<unsigned int>(threads);
+    }
+  }
+  return std::max(1u, std::thread::hardware_concurrency());
+}
+
+// How long GET /api/nodes may serve the same engine snapshot, from
+// CE_REST_API_SNAPSHOT_MS (default 100 ms, 0 disables reuse).
+static std::chrono::milliseconds snapshotMaxAge() {
+  if (const char* env = std::getenv("CE_REST_API_SNAPSHOT_MS")) {
+    return std::chrono::milliseconds(std::max(0, std::atoi(env)));
+  }
+  return std::chrono::milliseconds(100);
+}
+
+// Poll interval for the /api/ws/values stream, from CE_REST_API_STREAM_MS
+// (default 250 ms).
+static std::chrono::milliseconds streamInterval() {
+  if (const char* env = std::getenv("CE_REST_API_STREAM_MS")) {
+    int ms = std::atoi(env);
+    if (ms > 0) {
+      return std::chrono::milliseconds(ms);
+    }
+  }
+  return std::chrono::milliseconds(250);
+}
+
+// Minimum gap between coalesced PUT /api/nodes flushes, from
+// CE_REST_API_POSITION_FLUSH_MS (default 50 ms).
+static std::chrono::milliseconds positionFlushInterval() {
+  if (const char* env = std::getenv("CE_REST_API_POSITION_FLUSH_MS")) {
+    return std::chrono::milliseconds(std::max(0, std::atoi(env)));
+  }
+  return std::chrono::milliseconds(50);
+}
+
+// Smallest response body that is compressed, from
+// CE_REST_API_COMPRESS_MIN_BYTES (default 1024).
+static size_t compressMinBytes() {
+  if (const char* env = std::getenv("CE_REST_API_COMPRESS_MIN_BYTES")) {
+    return static_cast<size_t>(std::max(0, std::atoi(env)));
+  }
+  return 1024;
+}
+
+// Per-route thresholds from CE_REST_API_COMPRESS_ROUTES, a list of
+// prefix=bytes pairs such as "/api/flow=256,/metrics=0"; "off" disables a
+// route.
+static void compressRoutes(CompressionMiddleware& compression) {
+  const char* env = std::getenv("CE_REST_API_COMPRESS_ROUTES");
+  if (env == nullptr) {
+    return;
+  }
+  std::stringstream routes(env);
+  std::string route;
+  while (std::getline(routes, route, ',')) {
+    auto eq = route.find('=');
+    if (eq == std::string::npos) {
+      continue;
+    }
+    std::string bytes = route.substr(eq + 1);
+    compression.minBytes(route.substr(0, eq),
+                         bytes == "off" ? SIZE_MAX : static_cast<size_t>(std::max(0, std::atoi(bytes.c_str()))));
+  }
+}
+
+// How often GET /api/packages re-reads the package list to detect a new
+// package version, from CE_REST_API_PACKAGE_RECHECK_MS (default 5000 ms).
+static std::chrono::milliseconds packageRecheckInterval() {
+  if (const char* env = std::getenv("CE_REST_API_PACKAGE_RECHECK_MS")) {
+    return std::chrono::milliseconds(std::max(0, std::atoi(env)));
+  }
+  return std::chrono::milliseconds(5000);
+}
+
+// How long GET /api/flow may reuse the engine's flow JSON while no write
+// goes through this API, from CE_REST_API_FLOW_MS (default 1000 ms).
+static std::chrono::milliseconds flowMaxAge() {
+  if (const char* env = std::getenv("CE_REST_API_FLOW_MS")) {
+    return std::chrono::milliseconds(std::max(0, std::atoi(env)));
+  }
+  return std::chrono::milliseconds(1000);
+}
+
 int main() {
 
-  crow::App<crow::CORSHandler> app;
+  RestApp app;
   app.loglevel(crow::LogLevel::INFO);
-  app.concurrency(1);
+  app.concurrency(serverConcurrency());
 
   // Add CORS headers directly in a catchall route
   auto& cors = app.get_middleware<crow::CORSHandler>();
@@ -23,15 +119,28 @@ int main() {
       .methods("GET"_method, "POST"_method, "PUT"_method, "DELETE"_method, "OPTIONS"_method)
       .headers("Content-Type", "Authorization");
 
+  auto& compression = app.get_middleware<CompressionMiddleware>();
+  compression.minBytes(compressMinBytes());
+  compressRoutes(compression);
+
 
 
   EngineService engineService;
+  NodeSnapshotCache snapshots(engineService, snapshotMaxAge());
+  ValueStream valueStream(snapshots, streamInterval());
+  PositionCoalescer positions(engineService, snapshots, positionFlushInterval());
+  PackageCatalog packageCatalog(engineService, packageRecheckInterval());
+  FlowCache flowCache(engineService, snapshots, flowMaxAge());
   OpenAPIBuilder apiBuilder;
 
-  NodeRoutes::registerRoutes(app, engineService, apiBuilder);
-  EdgeRoutes::registerRoutes(app, engineService, apiBuilder);
-  PackageRoutes::registerRoutes(app, engineService, apiBuilder);
-  EngineRoutes::registerRoutes(app, engineService, apiBuilder);
+  NodeRoutes::registerRoutes(app, engineService, snapshots, positions, apiBuilder);
+  EdgeRoutes::registerRoutes(app, engineService, snapshots, apiBuilder);
+  GraphRoutes::registerRoutes(app, engineService, snapshots, positions, apiBuilder);
+  PackageRoutes::registerRoutes(app, engineService, packageCatalog, apiBuilder);
+  EngineRoutes::registerRoutes(app, flowCache, apiBuilder);
+  StreamRoutes::registerRoutes(app, valueStream, apiBuilder);
+  MetricsRoutes::registerRoutes(app, engineService, apiBuilder);
+  apiBuilder.freeze();
 
 
   // Your existing Swagger routes
@@ -41,46 +150,41 @@ int main() {
             // Get the host from request headers
             std::string host = req.get_header_value("Host");
             std::string scheme = "http://";  // or "https://" if you're using SSL
-
-            // Update the server URL dynamically
-            apiBuilder.updateServerUrl(scheme + host);
-
-            return apiBuilder.getSchema();
+            std::string serverUrl = scheme + host;
+
+            std::string etag = apiBuilder.etag(serverUrl);
+            if (HttpHeaders::noneMatch(req.get_header_value("If-None-Match"), etag)) {
+              crow::response notModified(304);
+              notModified.set_header("ETag", etag);
+              return notModified;
+            }
+
+            crow::response res(apiBuilder.document(serverUrl));
+            res.set_header("Content-Type", "application/json");
+            res.set_header("ETag", etag);
+            res.set_header("Cache-Control", "no-cache");
+            return res;
           });
 
+  StaticAssetCache assets;
+  assets.addContent("swagger", swagger::get_html(), "text/html");
+  assets.addFile("debug", "../debug/debug_graph.html", "text/html");
+  assets.addFile("graph", "../debug/graph.svg", "image/svg+xml", "SVG file not found");
+  assets.start();
+
   CROW_ROUTE(app, "/swagger")
-      ([]{
-        return crow::response(swagger::get_html());
+      ([&assets](const crow::request& req){
+        return assets.serve(req, "swagger");
       });
 
   CROW_ROUTE(app, "/debug")
-      ([]{
-        std::ifstream file("../debug/debug_graph.html");
-        if (!file.is_open()) {
-          return crow::response(404, "File not found");
-        }
-
-        std::string content((std::istreambuf_iterator<char>(file)),
-                            std::istreambuf_iterator<char>());
-
-        crow::response resp(content);
-        resp.set_header("Content-Type", "text/html");
-        return resp;
+      ([&assets](const crow::request& req){
+        return assets.serve(req, "debug");
       });
 
   CROW_ROUTE(app, "/graph.svg")
-      ([]{
-        std::ifstream file("../debug/graph.svg");
-        if (!file.is_open()) {
-          return crow::response(404, "SVG file not found");
-        }
-
-        std::string content((std::istreambuf_iterator<char>(file)),
-                            std::istreambuf_iterator<char>());
-
-        crow::response resp(content);
-        resp.set_header("Content-Type", "image/svg+xml");  // Important for SVG files
-        return resp;
+      ([&assets](const crow::request& req){
+        return assets.serve(req, "graph");
       });
 
   app.port(1668).run();
@@ -0,0 +1,318 @@
+//
+// Created by craig on 17/10/2026.
+//
+
+#ifndef METRICS_HPP_
+#define METRICS_HPP_
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <string>
+#include "crow.h"
+
+// Prometheus counters and histograms for /metrics. Recording is a handful of
+// relaxed atomic increments; nothing on the request path takes a lock.
+
+enum class EngineMethod : uint32_t {
+  ADD_NODE,
+  REMOVE_NODE,
+  ADD_EDGE,
+  REMOVE_EDGE,
+  SET_DEFAULT,
+  SET_OVERRIDE,
+  SET_FALLBACK,
+  GET_ALL_VALUES,
+  GET_AVAILABLE_PACKAGES,
+  GET_PACKAGE_JSON,
+  GET_FLOW_JSON,
+  GRAPH_BATCH,
+  VALUE_BATCH,
+  COUNT
+};
+
+inline const char* engineMethodName(EngineMethod method) {
+  static const char* const names[] = {
+      "addNode", "removeNode", "addEdge", "removeEdge",
+      "setDefault", "setOverride", "setFallback", "getAllValues",
+      "getAvailablePackages", "getPackageJson", "getFlowJson", "graphBatch",
+      "valueBatch",
+  };
+  return names[static_cast<uint32_t>(method)];
+}
+
+// Fixed-bucket histogram over integer observations (microseconds or bytes).
+class Histogram {
+ public:
+  static constexpr size_t MAX_BUCKETS = 12;
+
+  Histogram(const uint64_t* bounds, size_t bucketCount) : bounds(bounds), bucketCount(bucketCount) {}
+
+  void observe(uint64_t value) {
+    size_t i = 0;
+    while (i < bucketCount && value > bounds[i]) {
+      i++;
+    }
+    buckets[i].fetch_add(1, std::memory_order_relaxed);
+    sum.fetch_add(value, std::memory_order_relaxed);
+  }
+
+  // Appends the _bucket/_sum/_count series; `scale` converts observations to
+  // the exported unit (1e-6 for microseconds to seconds).
+  void render(std::string& out, const std::string& name, const std::string& labels, double scale) const {
+    uint64_t cumulative = 0;
+    std::string prefix = labels.empty() ? "{" : "{" + labels + ",";
+    for (size_t i = 0; i <= bucketCount; i++) {
+      cumulative += buckets[i].load(std::memory_order_relaxed);
+      out += name + "_bucket" + prefix + "le=\"";
+      out += i < bucketCount ? formatNumber(bounds[i] * scale) : "+Inf";
+      out += "\"} " + std::to_string(cumulative) + "\n";
+    }
+    std::string suffix = labels.empty() ? "" : "{" + labels + "}";
+    out += name + "_sum" + suffix + " " + formatNumber(sum.load(std::memory_order_relaxed) * scale) + "\n";
+    out += name + "_count" + suffix + " " + std::to_string(cumulative) + "\n";
+  }
+
+  uint64_t count() const {
+    uint64_t total = 0;
+    for (size_t i = 0; i <= bucketCount; i++) {
+      total += buckets[i].load(std::memory_order_relaxed);
+    }
+    return total;
+  }
+
+  static std::string formatNumber(double value) {
+    char buf[32];
+    snprintf(buf, sizeof(buf), "%.9g", value);
+    return buf;
+  }
+
+ private:
+  const uint64_t* bounds;
+  const size_t bucketCount;
+  std::array<std::atomic<uint64_t>, MAX_BUCKETS + 1> buckets{};
+  std::atomic<uint64_t> sum{0};
+};
+
+class Metrics {
+ public:
+  // Latency buckets in microseconds, size buckets in bytes.
+  static constexpr uint64_t LATENCY_US[] = {500, 1000, 2500, 5000, 10000, 25000, 50000,
+                                            100000, 250000, 500000, 1000000, 2500000};
+  static constexpr uint64_t SIZE_BYTES[] = {256, 1024, 4096, 16384, 65536, 262144,
+                                            1048576, 4194304, 16777216};
+  // Finer buckets for request body parsing, which is usually microseconds.
+  static constexpr uint64_t PARSE_US[] = {1, 2, 5, 10, 25, 50, 100, 250, 500, 1000, 5000, 25000};
+
+  struct RouteStats {
+    RouteStats(crow::HTTPMethod method, std::string route) : method(method), route(std::move(route)) {}
+
+    const crow::HTTPMethod method;
+    const std::string route;
+    std::array<std::atomic<uint64_t>, 5> responses{};  // by status class 1xx..5xx
+    Histogram latency{LATENCY_US, std::size(LATENCY_US)};
+    Histogram requestBytes{SIZE_BYTES, std::size(SIZE_BYTES)};
+    Histogram responseBytes{SIZE_BYTES, std::size(SIZE_BYTES)};
+  };
+
+  struct RpcStats {
+    std::atomic<uint64_t> errors{0};
+    Histogram latency{LATENCY_US, std::size(LATENCY_US)};
+    Histogram responseBytes{SIZE_BYTES, std::size(SIZE_BYTES)};
+  };
+
+  static Metrics& global() {
+    static Metrics metrics;
+    return metrics;
+  }
+
+  RpcStats& rpc(EngineMethod method) {
+    return rpcs[static_cast<uint32_t>(method)];
+  }
+
+  Histogram& snapshotSerialize() {
+    return serialize;
+  }
+
+  // Time to parse a JSON request body, in microseconds.
+  Histogram& jsonParse() {
+    return parse;
+  }
+
+  // Runs parseBody() and records its time under jsonParse().
+  template <typename Func>
+  auto timeJsonParse(Func&& parseBody) -> decltype(parseBody()) {
+    auto start = std::chrono::steady_clock::now();
+    auto result = parseBody();
+    parse.observe(std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now() - start).count());
+    return result;
+  }
+
+  // Stats for a route, keyed by method and path with numeric segments
+  // replaced by {id}. Slots are claimed with a CAS and never freed; once the
+  // table is full, further routes share the "other" slot. With claim unset
+  // (responses to paths that matched no route), only an existing slot is
+  // used, so arbitrary URLs cannot use up the table.
+  RouteStats& route(crow::HTTPMethod method, const std::string& url, bool claim = true) {
+    char key[128];
+    size_t len = normalize(url, key, sizeof(key));
+    uint64_t hash = 1469598103934665603ull ^ static_cast<uint64_t>(method);
+    for (size_t i = 0; i < len; i++) {
+      hash = (hash ^ static_cast<unsigned char>(key[i])) * 1099511628211ull;
+    }
+
+    for (size_t probe = 0; probe < ROUTE_SLOTS; probe++) {
+      auto& slot = routes[(hash + probe) % ROUTE_SLOTS];
+      RouteStats* stats = slot.load(std::memory_order_acquire);
+      if (stats == nullptr) {
+        if (!claim) {
+          return other;
+        }
+        auto* created = new RouteStats(method, std::string(key, len));
+        if (slot.compare_exchange_strong(stats, created, std::memory_order_acq_rel)) {
+          return *created;
+        }
+        delete created;
+      }
+      if (stats->method == method && stats->route.size() == len && memcmp(stats->route.data(), key, len) == 0) {
+        return *stats;
+      }
+    }
+    return other;
+  }
+
+  std::string render(uint64_t reconnects) const {
+    std::string out;
+    static const char* const classes[] = {"1xx", "2xx", "3xx", "4xx", "5xx"};
+
+    out += "# TYPE ce_http_responses_total counter\n";
+    forEachRoute([&](const RouteStats& stats, const std::string& labels) {
+      for (size_t i = 0; i < 5; i++) {
+        auto count = stats.responses[i].load(std::memory_order_relaxed);
+        if (count > 0) {
+          out += "ce_http_responses_total{" + labels + ",code=\"" + classes[i] + "\"} " +
+              std::to_string(count) + "\n";
+        }
+      }
+    });
+    out += "# TYPE ce_http_request_duration_seconds histogram\n";
+    forEachRoute([&](const RouteStats& stats, const std::string& labels) {
+      stats.latency.render(out, "ce_http_request_duration_seconds", labels, 1e-6);
+    });
+    out += "# TYPE ce_http_request_bytes histogram\n";
+    forEachRoute([&](const RouteStats& stats, const std::string& labels) {
+      stats.requestBytes.render(out, "ce_http_request_bytes", labels, 1);
+    });
+    out += "# TYPE ce_http_response_bytes histogram\n";
+    forEachRoute([&](const RouteStats& stats, const std::string& labels) {
+      stats.responseBytes.render(out, "ce_http_response_bytes", labels, 1);
+    });
+
+    out += "# TYPE ce_engine_rpc_duration_seconds histogram\n";
+    for (uint32_t i = 0; i < static_cast<uint32_t>(EngineMethod::COUNT); i++) {
+      std::string labels = std::string("method=\"") + engineMethodName(static_cast<EngineMethod>(i)) + "\"";
+      rpcs[i].latency.render(out, "ce_engine_rpc_duration_seconds", labels, 1e-6);
+    }
+    out += "# TYPE ce_engine_rpc_errors_total counter\n";
+    for (uint32_t i = 0; i < static_cast<uint32_t>(EngineMethod::COUNT); i++) {
+      out += std::string("ce_engine_rpc_errors_total{method=\"") + engineMethodName(static_cast<EngineMethod>(i)) +
+          "\"} " + std::to_string(rpcs[i].errors.load(std::memory_order_relaxed)) + "\n";
+    }
+    out += "# TYPE ce_engine_response_bytes histogram\n";
+    for (uint32_t i = 0; i < static_cast<uint32_t>(EngineMethod::COUNT); i++) {
+      if (rpcs[i].responseBytes.count() > 0) {
+        std::string labels = std::string("method=\"") + engineMethodName(static_cast<EngineMethod>(i)) + "\"";
+        rpcs[i].responseBytes.render(out, "ce_engine_response_bytes", labels, 1);
+      }
+    }
+
+    out += "# TYPE ce_snapshot_serialize_seconds histogram\n";
+    serialize.render(out, "ce_snapshot_serialize_seconds", "", 1e-6);
+    out += "# TYPE ce_json_parse_seconds histogram\n";
+    parse.render(out, "ce_json_parse_seconds", "", 1e-6);
+    out += "# TYPE ce_engine_reconnects_total counter\n";
+    out += "ce_engine_reconnects_total " + std::to_string(reconnects) + "\n";
+    return out;
+  }
+
+ private:
+  static constexpr size_t ROUTE_SLOTS = 128;
+
+  std::array<std::atomic<RouteStats*>, ROUTE_SLOTS> routes{};
+  RouteStats other{crow::HTTPMethod::Get, "other"};
+  std::array<RpcStats, static_cast<size_t>(EngineMethod::COUNT)> rpcs;
+  Histogram serialize{LATENCY_US, std::size(LATENCY_US)};
+  Histogram parse{PARSE_US, std::size(PARSE_US)};
+
+  Metrics() = default;
+
+  template <typename Func>
+  void forEachRoute(Func&& func) const {
+    for (auto& slot : routes) {
+      if (auto* stats = slot.load(std::memory_order_acquire)) {
+        func(*stats, std::string("method=\"") + crow::method_name(stats->method) + "\",route=\"" + stats->route + "\"");
+      }
+    }
+    if (other.latency.count() > 0) {
+      func(other, "method=\"OTHER\",route=\"other\"");
+    }
+  }
+
+  // Copies the path (without query) into `out`, replacing all-digit segments
+  // with {id} and dropping any character that would need escaping in a label.
+  static size_t normalize(const std::string& url, char* out, size_t capacity) {
+    size_t len = 0;
+    size_t end = url.find('?');
+    if (end == std::string::npos) {
+      end = url.size();
+    }
+    for (size_t i = 0; i < end && len < capacity;) {
+      size_t next = url.find('/', i + 1);
+      if (next == std::string::npos || next > end) {
+        next = end;
+      }
+      bool numeric = next > i + 1;
+      for (size_t j = i + 1; j < next && numeric; j++) {
+        numeric = url[j] >= '0' && url[j] <= '9';
+      }
+      const char* segment = numeric ? "/{id}" : nullptr;
+      size_t segmentLen = numeric ? 5 : next - i;
+      for (size_t j = 0; j < segmentLen && len < capacity; j++) {
+        char c = numeric ? segment[j] : url[i + j];
+        if (c != '"' && c != '\\' && c != '\n') {
+          out[len++] = c;
+        }
+      }
+      i = next;
+    }
+    return len;
+  }
+};
+
+// Times every request and records its status class and response size
+// against the normalized route. 404s are recorded against a route only if
+// it is already known; the rest go to "other".
+struct MetricsMiddleware {
+  struct context {
+    std::chrono::steady_clock::time_point start;
+  };
+
+  void before_handle(crow::request&, crow::response&, context& ctx) {
+    ctx.start = std::chrono::steady_clock::now();
+  }
+
+  void after_handle(crow::request& req, crow::response& res, context& ctx) {
+    auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now() - ctx.start);
+    auto& stats = Metrics::global().route(req.method, req.url, res.code != 404);
+    size_t statusClass = res.code >= 100 && res.code < 600 ? res.code / 100 - 1 : 4;
+    stats.responses[statusClass].fetch_add(1, std::memory_order_relaxed);
+    stats.latency.observe(elapsed.count());
+    stats.requestBytes.observe(req.body.size());
+    stats.responseBytes.observe(res.body.size());
+  }
+};
+
+#endif //METRICS_HPP_
@@ -0,0 +1,53 @@
+//
+// Created by craig on 17/10/2026.
+//
+
+#ifndef METRICS_ROUTES_HPP_
+#define METRICS_ROUTES_HPP_
+
+#include "crow.h"
+#include "rest_app.hpp"
+#include "engine_service.hpp"
+#include "metrics.hpp"
+#include "open_api_builder.hpp"
+
+class MetricsRoutes {
+ public:
+  static void registerRoutes(RestApp& app, EngineService& engineService,
+                             OpenAPIBuilder& apiBuilder) {
+    setupSwaggerDocs(apiBuilder);
+    setupRoutes(app, engineService);
+  }
+
+ private:
+  static void setupSwaggerDocs(OpenAPIBuilder& apiBuilder) {
+    apiBuilder.addEndpoint(
+        "/metrics",
+        "GET",
+        "Prometheus metrics: per-route request counts, latency, request size and response size histograms, "
+        "per-Engine-method RPC latency and errors, JSON body parse and snapshot serialization time, "
+        "and reconnects",
+        crow::json::wvalue(),  // no request body
+        {{"200", {
+            {"description", "Metrics in the Prometheus text exposition format"},
+            {"content", {
+                {"text/plain", {
+                    {"schema", {{"type", "string"}}}
+                }}
+            }}
+        }}}
+    );
+  }
+
+  static void setupRoutes(RestApp& app, EngineService& engineService) {
+    CROW_ROUTE(app, "/metrics")
+        .methods("GET"_method)
+            ([&engineService]() {
+              crow::response res(Metrics::global().render(engineService.ReconnectCount()));
+              res.set_header("Content-Type", "text/plain; version=0.0.4");
+              return res;
+            });
+  }
+};
+
+#endif //METRICS_ROUTES_HPP_
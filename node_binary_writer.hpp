@@ -0,0 +1,297 @@
+//
+// Created by craig on 17/10/2026.
+//
+
+#ifndef NODE_BINARY_WRITER_HPP_
+#define NODE_BINARY_WRITER_HPP_
+
+#include <cstring>
+#include <string>
+#include "node_projection.hpp"
+#include "schemas/package.capnp.h"
+
+// Writes GetAllValues readers as CBOR or MessagePack, with the same keys and
+// nesting as NodeJsonWriter. Maps and arrays carry their lengths up front,
+// which both formats allow; doubles that survive the round trip through
+// float are written as 4-byte floats.
+class NodeBinaryWriter {
+ public:
+  enum class Format {
+    CBOR,
+    MSGPACK,
+  };
+
+  static const char* contentType(Format format) {
+    return format == Format::CBOR ? "application/cbor" : "application/msgpack";
+  }
+
+  NodeBinaryWriter(std::string& out, Format format) : out(out), format(format) {}
+
+  void writeNodes(capnp::List<Node, capnp::Kind::STRUCT>::Reader nodes,
+                  const NodeProjection& projection = NodeProjection::all()) {
+    writeArray(nodes.size());
+    for (auto node : nodes) {
+      writeNode(node, projection);
+    }
+  }
+
+  void writeNode(Node::Reader node, const NodeProjection& projection = NodeProjection::all()) {
+    uint32_t fields = projection.node & NODE_FIELDS;
+    writeMap(__builtin_popcount(fields));
+    if (fields & NodeProjection::INSTANCE_ID) {
+      writeKey("instanceId");
+      writeUint(node.getInstanceId());
+    }
+    if (fields & NodeProjection::NODE_NAME) {
+      writeKey("nodeName");
+      writeString(node.getNodeName());
+    }
+    if (fields & NodeProjection::HAS_CHILDREN) {
+      writeKey("hasChildren");
+      writeBool(node.getHasChildren());
+    }
+    if (fields & NodeProjection::NODE_STATUS) {
+      writeKey("nodeStatus");
+      writeNodeStatus(node.getNodeStatus(), projection.status);
+    }
+    if (fields & NodeProjection::INPUTS) {
+      writeKey("inputs");
+      auto inputs = node.getInputs();
+      writeArray(inputs.size());
+      for (auto io : inputs) {
+        writeIO(io, "default_value", projection.inputs);
+      }
+    }
+    if (fields & NodeProjection::OUTPUTS) {
+      writeKey("outputs");
+      auto outputs = node.getOutputs();
+      writeArray(outputs.size());
+      for (auto io : outputs) {
+        writeIO(io, "fallback_value", projection.outputs);  // renamed for outputs
+      }
+    }
+  }
+
+  void writeNodeStatus(NodeStatus::Reader nodeStatus, uint32_t fields = NodeProjection::ALL) {
+    fields &= STATUS_FIELDS;
+    writeMap(__builtin_popcount(fields));
+    if (fields & NodeProjection::STATUS) {
+      writeKey("status");
+      writeString(nodeStatus.getStatus());
+    }
+    if (fields & NodeProjection::COUNT) {
+      writeKey("count");
+      writeUint(nodeStatus.getCount());
+    }
+    if (fields & NodeProjection::DURATION) {
+      writeKey("duration");
+      writeUint(nodeStatus.getDuration());
+    }
+  }
+
+  void writeIO(IO::Reader io, const char* defaultKey, uint32_t fields = NodeProjection::ALL) {
+    fields &= IO_FIELDS;
+    writeMap(__builtin_popcount(fields));
+    if (fields & NodeProjection::NAME) {
+      writeKey("name");
+      writeString(io.getName());
+    }
+    if (fields & NodeProjection::VALUE) {
+      writeKey("value");
+      writeFlexValue(io.getValue());
+    }
+    if (fields & NodeProjection::OVERRIDE) {
+      writeKey("override");
+      writeBool(io.getOverride());
+    }
+    if (fields & NodeProjection::OVERRIDE_VALUE) {
+      writeKey("override_value");
+      writeFlexValue(io.getOverrideValue());
+    }
+    if (fields & NodeProjection::DEFAULT_VALUE) {
+      writeKey(defaultKey);
+      writeFlexValue(io.getDefaultValue());
+    }
+  }
+
+  void writeFlexValue(FlexValueCap::Reader flex) {
+    switch (flex.which()) {
+      case FlexValueCap::INT_VAL:
+        writeInt(flex.getIntVal());
+        return;
+      case FlexValueCap::UINT_VAL:
+        writeUint(flex.getUintVal());
+        return;
+      case FlexValueCap::BOOL_VAL:
+        writeBool(flex.getBoolVal());
+        return;
+      case FlexValueCap::DOUBLE_VAL:
+        writeDouble(flex.getDoubleVal());
+        return;
+      case FlexValueCap::STRING_VAL:
+        writeString(flex.getStringVal());
+        return;
+    }
+    writeNull();
+  }
+
+  void writeArray(uint64_t size) {
+    if (format == Format::CBOR) {
+      cborHead(4, size);
+    } else {
+      msgpackHead(0x90, 0xdc, size);
+    }
+  }
+
+  void writeMap(uint64_t size) {
+    if (format == Format::CBOR) {
+      cborHead(5, size);
+    } else {
+      msgpackHead(0x80, 0xde, size);
+    }
+  }
+
+  void writeKey(const char* key) {
+    writeString(key, strlen(key));
+  }
+
+  void writeNull() {
+    out.push_back(static_cast<char>(format == Format::CBOR ? 0xf6 : 0xc0));
+  }
+
+  void writeBool(bool value) {
+    if (format == Format::CBOR) {
+      out.push_back(static_cast<char>(value ? 0xf5 : 0xf4));
+    } else {
+      out.push_back(static_cast<char>(value ? 0xc3 : 0xc2));
+    }
+  }
+
+  void writeUint(uint64_t value) {
+    if (format == Format::CBOR) {
+      cborHead(0, value);
+    } else if (value < 0x80) {
+      out.push_back(static_cast<char>(value));
+    } else if (value <= 0xff) {
+      out.push_back(static_cast<char>(0xcc));
+      bigEndian(value, 1);
+    } else if (value <= 0xffff) {
+      out.push_back(static_cast<char>(0xcd));
+      bigEndian(value, 2);
+    } else if (value <= 0xffffffff) {
+      out.push_back(static_cast<char>(0xce));
+      bigEndian(value, 4);
+    } else {
+      out.push_back(static_cast<char>(0xcf));
+      bigEndian(value, 8);
+    }
+  }
+
+  void writeInt(int64_t value) {
+    if (value >= 0) {
+      writeUint(static_cast<uint64_t>(value));
+    } else if (format == Format::CBOR) {
+      cborHead(1, static_cast<uint64_t>(-1 - value));
+    } else if (value >= -32) {
+      out.push_back(static_cast<char>(value));  // negative fixint
+    } else if (value >= INT8_MIN) {
+      out.push_back(static_cast<char>(0xd0));
+      bigEndian(static_cast<uint64_t>(value), 1);
+    } else if (value >= INT16_MIN) {
+      out.push_back(static_cast<char>(0xd1));
+      bigEndian(static_cast<uint64_t>(value), 2);
+    } else if (value >= INT32_MIN) {
+      out.push_back(static_cast<char>(0xd2));
+      bigEndian(static_cast<uint64_t>(value), 4);
+    } else {
+      out.push_back(static_cast<char>(0xd3));
+      bigEndian(static_cast<uint64_t>(value), 8);
+    }
+  }
+
+  void writeDouble(double value) {
+    auto narrow = static_cast<float>(value);
+    if (static_cast<double>(narrow) == value) {
+      uint32_t bits;
+      memcpy(&bits, &narrow, sizeof(bits));
+      out.push_back(static_cast<char>(format == Format::CBOR ? 0xfa : 0xca));
+      bigEndian(bits, 4);
+    } else {
+      uint64_t bits;
+      memcpy(&bits, &value, sizeof(bits));
+      out.push_back(static_cast<char>(format == Format::CBOR ? 0xfb : 0xcb));
+      bigEndian(bits, 8);
+    }
+  }
+
+  void writeString(capnp::Text::Reader text) {
+    writeString(text.cStr(), text.size());
+  }
+
+  void writeString(const char* str, size_t size) {
+    if (format == Format::CBOR) {
+      cborHead(3, size);
+    } else if (size < 32) {
+      out.push_back(static_cast<char>(0xa0 | size));
+    } else if (size <= 0xff) {
+      out.push_back(static_cast<char>(0xd9));
+      bigEndian(size, 1);
+    } else {
+      msgpackHead(0, 0xda, size);  // str16 / str32
+    }
+    out.append(str, size);
+  }
+
+ private:
+  static constexpr uint32_t NODE_FIELDS = NodeProjection::INSTANCE_ID | NodeProjection::NODE_NAME |
+      NodeProjection::HAS_CHILDREN | NodeProjection::NODE_STATUS | NodeProjection::INPUTS | NodeProjection::OUTPUTS;
+  static constexpr uint32_t STATUS_FIELDS = NodeProjection::STATUS | NodeProjection::COUNT | NodeProjection::DURATION;
+  static constexpr uint32_t IO_FIELDS = NodeProjection::NAME | NodeProjection::VALUE | NodeProjection::OVERRIDE |
+      NodeProjection::OVERRIDE_VALUE | NodeProjection::DEFAULT_VALUE;
+
+  std::string& out;
+  const Format format;
+
+  void bigEndian(uint64_t value, int bytes) {
+    for (int shift = (bytes - 1) * 8; shift >= 0; shift -= 8) {
+      out.push_back(static_cast<char>(value >> shift));
+    }
+  }
+
+  // CBOR initial byte for `major` with its argument in the shortest form.
+  void cborHead(uint8_t major, uint64_t value) {
+    uint8_t type = major << 5;
+    if (value < 24) {
+      out.push_back(static_cast<char>(type | value));
+    } else if (value <= 0xff) {
+      out.push_back(static_cast<char>(type | 24));
+      bigEndian(value, 1);
+    } else if (value <= 0xffff) {
+      out.push_back(static_cast<char>(type | 25));
+      bigEndian(value, 2);
+    } else if (value <= 0xffffffff) {
+      out.push_back(static_cast<char>(type | 26));
+      bigEndian(value, 4);
+    } else {
+      out.push_back(static_cast<char>(type | 27));
+      bigEndian(value, 8);
+    }
+  }
+
+  // MessagePack array/map/str header: the fix form (fixBase | size) below 16,
+  // else the 16-bit form at `wide` or the 32-bit form at `wide + 1`. A zero
+  // fixBase skips the fix form.
+  void msgpackHead(uint8_t fixBase, uint8_t wide, uint64_t size) {
+    if (fixBase != 0 && size < 16) {
+      out.push_back(static_cast<char>(fixBase | size));
+    } else if (size <= 0xffff) {
+      out.push_back(static_cast<char>(wide));
+      bigEndian(size, 2);
+    } else {
+      out.push_back(static_cast<char>(wide + 1));
+      bigEndian(size, 4);
+    }
+  }
+};
+
+#endif //NODE_BINARY_WRITER_HPP_
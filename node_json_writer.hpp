@@ -0,0 +1,225 @@
+//
+// Created by craig on 17/10/2026.
+//
+
+#ifndef NODE_JSON_WRITER_HPP_
+#define NODE_JSON_WRITER_HPP_
+
+#include <charconv>
+#include <cmath>
+#include <string>
+#include "node_projection.hpp"
+#include "schemas/package.capnp.h"
+
+// Writes GetAllValues readers straight to JSON text, producing the same
+// document as a crow::json::wvalue conversion without building the tree.
+// A NodeProjection limits which fields are written.
+class NodeJsonWriter {
+ public:
+  explicit NodeJsonWriter(std::string& out) : out(out) {}
+
+  void writeNodes(capnp::List<Node, capnp::Kind::STRUCT>::Reader nodes,
+                  const NodeProjection& projection = NodeProjection::all()) {
+    out.push_back('[');
+    for (size_t i = 0; i < nodes.size(); i++) {
+      if (i > 0) {
+        out.push_back(',');
+      }
+      writeNode(nodes[i], projection);
+    }
+    out.push_back(']');
+  }
+
+  void writeNode(Node::Reader node, const NodeProjection& projection = NodeProjection::all()) {
+    uint32_t fields = projection.node;
+    bool first = true;
+    out.push_back('{');
+    if (fields & NodeProjection::INSTANCE_ID) {
+      key(first, "\"instanceId\":");
+      writeUint(node.getInstanceId());
+    }
+    if (fields & NodeProjection::NODE_NAME) {
+      key(first, "\"nodeName\":");
+      writeString(node.getNodeName());
+    }
+    if (fields & NodeProjection::HAS_CHILDREN) {
+      key(first, "\"hasChildren\":");
+      writeBool(node.getHasChildren());
+    }
+    if (fields & NodeProjection::NODE_STATUS) {
+      key(first, "\"nodeStatus\":");
+      writeNodeStatus(node.getNodeStatus(), projection.status);
+    }
+
+    if (fields & NodeProjection::INPUTS) {
+      key(first, "\"inputs\":[");
+      auto inputs = node.getInputs();
+      for (size_t i = 0; i < inputs.size(); i++) {
+        if (i > 0) {
+          out.push_back(',');
+        }
+        writeIO(inputs[i], "\"default_value\":", projection.inputs);
+      }
+      out.push_back(']');
+    }
+
+    if (fields & NodeProjection::OUTPUTS) {
+      key(first, "\"outputs\":[");
+      auto outputs = node.getOutputs();
+      for (size_t i = 0; i < outputs.size(); i++) {
+        if (i > 0) {
+          out.push_back(',');
+        }
+        writeIO(outputs[i], "\"fallback_value\":", projection.outputs);  // renamed for outputs
+      }
+      out.push_back(']');
+    }
+    out.push_back('}');
+  }
+
+  void writeNodeStatus(NodeStatus::Reader nodeStatus, uint32_t fields = NodeProjection::ALL) {
+    bool first = true;
+    out.push_back('{');
+    if (fields & NodeProjection::STATUS) {
+      key(first, "\"status\":");
+      writeString(nodeStatus.getStatus());
+    }
+    if (fields & NodeProjection::COUNT) {
+      key(first, "\"count\":");
+      writeUint(nodeStatus.getCount());
+    }
+    if (fields & NodeProjection::DURATION) {
+      key(first, "\"duration\":");
+      writeUint(nodeStatus.getDuration());
+    }
+    out.push_back('}');
+  }
+
+  // defaultKey carries the quoted key and colon, e.g. "\"default_value\":".
+  void writeIO(IO::Reader io, const char* defaultKey, uint32_t fields = NodeProjection::ALL) {
+    bool first = true;
+    out.push_back('{');
+    if (fields & NodeProjection::NAME) {
+      key(first, "\"name\":");
+      writeString(io.getName());
+    }
+    if (fields & NodeProjection::VALUE) {
+      key(first, "\"value\":");
+      writeFlexValue(io.getValue());
+    }
+    if (fields & NodeProjection::OVERRIDE) {
+      key(first, "\"override\":");
+      writeBool(io.getOverride());
+    }
+    if (fields & NodeProjection::OVERRIDE_VALUE) {
+      key(first, "\"override_value\":");
+      writeFlexValue(io.getOverrideValue());
+    }
+    if (fields & NodeProjection::DEFAULT_VALUE) {
+      key(first, defaultKey);
+      writeFlexValue(io.getDefaultValue());
+    }
+    out.push_back('}');
+  }
+
+  void writeFlexValue(FlexValueCap::Reader flex) {
+    switch (flex.which()) {
+      case FlexValueCap::INT_VAL:
+        writeInt(flex.getIntVal());
+        return;
+      case FlexValueCap::UINT_VAL:
+        writeUint(flex.getUintVal());
+        return;
+      case FlexValueCap::BOOL_VAL:
+        writeBool(flex.getBoolVal());
+        return;
+      case FlexValueCap::DOUBLE_VAL:
+        writeDouble(flex.getDoubleVal());
+        return;
+      case FlexValueCap::STRING_VAL:
+        writeString(flex.getStringVal());
+        return;
+    }
+    out += "null";
+  }
+
+  void writeRaw(const char* text) {
+    out += text;
+  }
+
+  void writeBool(bool value) {
+    out += value ? "true" : "false";
+  }
+
+  void writeInt(int64_t value) {
+    char buf[24];
+    auto result = std::to_chars(buf, buf + sizeof(buf), value);
+    out.append(buf, result.ptr);
+  }
+
+  void writeUint(uint64_t value) {
+    char buf[24];
+    auto result = std::to_chars(buf, buf + sizeof(buf), value);
+    out.append(buf, result.ptr);
+  }
+
+  // Shortest form that round-trips, the same under any locale; NaN and
+  // infinities become null, as Crow does.
+  void writeDouble(double value) {
+    if (!std::isfinite(value)) {
+      out += "null";
+      return;
+    }
+    char buf[32];
+    auto result = std::to_chars(buf, buf + sizeof(buf), value);
+    out.append(buf, result.ptr);
+  }
+
+  void writeString(capnp::Text::Reader text) {
+    writeString(text.cStr(), text.size());
+  }
+
+  void writeString(const char* str, size_t size) {
+    static const char hex[] = "0123456789abcdef";
+    out.push_back('"');
+    size_t run = 0;
+    for (size_t i = 0; i < size; i++) {
+      unsigned char c = static_cast<unsigned char>(str[i]);
+      if (c >= 0x20 && c != '"' && c != '\\') {
+        continue;
+      }
+      out.append(str + run, i - run);
+      run = i + 1;
+      switch (c) {
+        case '"': out += "\\\""; break;
+        case '\\': out += "\\\\"; break;
+        case '\n': out += "\\n"; break;
+        case '\r': out += "\\r"; break;
+        case '\t': out += "\\t"; break;
+        case '\b': out += "\\b"; break;
+        case '\f': out += "\\f"; break;
+        default:
+          out += "\\u00";
+          out.push_back(hex[c >> 4]);
+          out.push_back(hex[c & 0xf]);
+      }
+    }
+    out.append(str + run, size - run);
+    out.push_back('"');
+  }
+
+ private:
+  std::string& out;
+
+  // Writes a quoted key (with colon), preceded by a comma unless it is the
+  // first member of the object.
+  void key(bool& first, const char* quotedKey) {
+    if (!first) {
+      out.push_back(',');
+    }
+    first = false;
+    out += quotedKey;
+  }
+};
+
+#endif //NODE_JSON_WRITER_HPP_
@@ -0,0 +1,162 @@
+//
+// Created by craig on 17/10/2026.
+//
+
+#ifndef NODE_PROJECTION_HPP_
+#define NODE_PROJECTION_HPP_
+
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+
+// Which node fields NodeJsonWriter emits, compiled from a `fields=` query
+// such as "instanceId,outputs.value". A bare group ("inputs", "nodeStatus")
+// selects all of its members.
+struct NodeProjection {
+  enum NodeField : uint32_t {
+    INSTANCE_ID = 1 << 0,
+    NODE_NAME = 1 << 1,
+    HAS_CHILDREN = 1 << 2,
+    NODE_STATUS = 1 << 3,
+    INPUTS = 1 << 4,
+    OUTPUTS = 1 << 5,
+  };
+
+  enum IOField : uint32_t {
+    NAME = 1 << 0,
+    VALUE = 1 << 1,
+    OVERRIDE = 1 << 2,
+    OVERRIDE_VALUE = 1 << 3,
+    DEFAULT_VALUE = 1 << 4,  // default_value on inputs, fallback_value on outputs
+  };
+
+  enum StatusField : uint32_t {
+    STATUS = 1 << 0,
+    COUNT = 1 << 1,
+    DURATION = 1 << 2,
+  };
+
+  static constexpr uint32_t ALL = ~0u;
+
+  uint32_t node = ALL;
+  uint32_t status = ALL;
+  uint32_t inputs = ALL;
+  uint32_t outputs = ALL;
+
+  static const NodeProjection& all() {
+    static const NodeProjection projection;
+    return projection;
+  }
+
+  // Returns the plan for `fields`, compiling it on first use. Returns null if
+  // a field name is unknown or the list names no field. The plans for the
+  // MAX_CACHED most recently used field sets are kept.
+  static std::shared_ptr<const NodeProjection> compile(const std::string& fields) {
+    static std::mutex mutex;
+    static std::list<std::string> recent;  // most recently used first
+    static std::unordered_map<std::string, std::pair<std::shared_ptr<const NodeProjection>,
+                                                     std::list<std::string>::iterator>> cache;
+
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      auto found = cache.find(fields);
+      if (found != cache.end()) {
+        recent.splice(recent.begin(), recent, found->second.second);
+        return found->second.first;
+      }
+    }
+
+    auto plan = parse(fields);
+    if (plan) {
+      std::lock_guard<std::mutex> lock(mutex);
+      if (cache.find(fields) != cache.end()) {
+        return plan;  // compiled by another thread meanwhile
+      }
+      if (cache.size() >= MAX_CACHED) {
+        cache.erase(recent.back());
+        recent.pop_back();
+      }
+      recent.push_front(fields);
+      cache.emplace(fields, std::make_pair(plan, recent.begin()));
+    }
+    return plan;
+  }
+
+ private:
+  static constexpr size_t MAX_CACHED = 64;
+
+  static std::shared_ptr<const NodeProjection> parse(std::string_view fields) {
+    auto plan = std::make_shared<NodeProjection>();
+    plan->node = plan->status = plan->inputs = plan->outputs = 0;
+
+    // Every element must name a field, so "", "," and "a," are all rejected.
+    while (true) {
+      auto comma = fields.find(',');
+      if (!addField(*plan, fields.substr(0, comma))) {
+        return nullptr;
+      }
+      if (comma == std::string_view::npos) {
+        return plan;
+      }
+      fields = fields.substr(comma + 1);
+    }
+  }
+
+  static bool addField(NodeProjection& plan, std::string_view field) {
+    auto dot = field.find('.');
+    auto group = field.substr(0, dot);
+    auto member = dot == std::string_view::npos ? std::string_view() : field.substr(dot + 1);
+
+    if (group == "instanceId" && member.empty()) {
+      plan.node |= INSTANCE_ID;
+    } else if (group == "nodeName" && member.empty()) {
+      plan.node |= NODE_NAME;
+    } else if (group == "hasChildren" && member.empty()) {
+      plan.node |= HAS_CHILDREN;
+    } else if (group == "nodeStatus") {
+      plan.node |= NODE_STATUS;
+      return addMember(plan.status, member, statusField);
+    } else if (group == "inputs") {
+      plan.node |= INPUTS;
+      return addMember(plan.inputs, member, ioField);
+    } else if (group == "outputs") {
+      plan.node |= OUTPUTS;
+      return addMember(plan.outputs, member, ioField);
+    } else {
+      return false;
+    }
+    return true;
+  }
+
+  static bool addMember(uint32_t& mask, std::string_view member, uint32_t (*lookup)(std::string_view)) {
+    if (member.empty()) {
+      mask = ALL;
+      return true;
+    }
+    uint32_t bit = lookup(member);
+    mask |= bit;
+    return bit != 0;
+  }
+
+  static uint32_t ioField(std::string_view member) {
+    if (member == "name") return NAME;
+    if (member == "value") return VALUE;
+    if (member == "override") return OVERRIDE;
+    if (member == "override_value") return OVERRIDE_VALUE;
+    if (member == "default_value" || member == "fallback_value") return DEFAULT_VALUE;
+    return 0;
+  }
+
+  static uint32_t statusField(std::string_view member) {
+    if (member == "status") return STATUS;
+    if (member == "count") return COUNT;
+    if (member == "duration") return DURATION;
+    return 0;
+  }
+};
+
+#endif //NODE_PROJECTION_HPP_
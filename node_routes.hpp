@@ -6,16 +6,27 @@
 #define ENGINE_ROUTES_HPP_
 
 
+#include <optional>
+#include <tuple>
 #include "crow.h"
+#include "rest_app.hpp"
+#include "capnp_body.hpp"
+#include "http_headers.hpp"
+#include "json_body_parser.hpp"
+#include "node_binary_writer.hpp"
 #include "engine_service.hpp"
 #include "open_api_builder.hpp"
+#include "node_snapshot_cache.hpp"
+#include "position_coalescer.hpp"
 
 
 class NodeRoutes {
  public:
-  static void registerRoutes(crow::App<crow::CORSHandler>& app, EngineService& engineService, OpenAPIBuilder& apiBuilder) {
+  static void registerRoutes(RestApp& app, EngineService& engineService,
+                             NodeSnapshotCache& snapshots, PositionCoalescer& positions,
+                             OpenAPIBuilder& apiBuilder) {
     setupSwaggerDocs(apiBuilder);
-    setupRoutes(app, engineService);
+    setupRoutes(app, engineService, snapshots, positions);
 
   }
 
@@ -123,6 +134,50 @@ class NodeRoutes {
         {instanceIdParam}  // Add parameter here
     );
 
+    auto valueWriteSchema = OpenAPIBuilder::createObjectSchema({
+                                                                   {"instanceId", "integer"},
+                                                                   {"name", "string"},
+                                                                   {"kind", "string"},
+                                                                   {"duration", "integer"},
+                                                                   {"active", "boolean"},
+                                                                   {"input", "boolean"}
+                                                               });
+    valueWriteSchema["properties"]["kind"]["enum"][0] = "default";
+    valueWriteSchema["properties"]["kind"]["enum"][1] = "override";
+    valueWriteSchema["properties"]["kind"]["enum"][2] = "fallback";
+    valueWriteSchema["properties"]["value"] = createFlexValueSchema();
+
+    crow::json::wvalue valueBatchSchema;
+    valueBatchSchema["type"] = "array";
+    valueBatchSchema["items"] = std::move(valueWriteSchema);
+
+    apiBuilder.addEndpoint(
+        "/api/nodes/values/batch",
+        "PUT",
+        "Set many default, override and fallback values in one request. "
+        "duration is required for overrides; active and input default to false",
+        std::move(valueBatchSchema),
+        {{"200", {
+            {"description", "Per-entry results, in request order"},
+            {"content", {
+                {"application/json", {
+                    {"schema", {
+                        {"type", "object"},
+                        {"properties", {
+                            {"results", {
+                                {"type", "array"},
+                                {"items", OpenAPIBuilder::createObjectSchema({
+                                                                                 {"ok", "boolean"},
+                                                                                 {"error", "string"}
+                                                                             })}
+                            }}
+                        }}
+                    }}
+                }}
+            }}
+        }}}
+    );
+
     apiBuilder.addEndpoint(
         "/api/nodes",
         "POST",
@@ -146,8 +201,9 @@ class NodeRoutes {
         "PUT",
         "Update node position",
         updateNodeDetailsSchema,
-        {{"200", {
-            {"description", "Node position updated successfully"},
+        {{"202", {
+            {"description", "Position accepted; it is sent to the engine with the next coalesced flush. "
+                            "name is included when the node is in the cached snapshot"},
             {"content", {
                 {"application/json", {
                     {"schema", OpenAPIBuilder::createObjectSchema({
@@ -179,6 +235,60 @@ class NodeRoutes {
         nodeParameters
     );
 
+    auto fieldsParam = OpenAPIBuilder::createParameter(
+        "fields",
+        "query",
+        false,
+        "string",
+        "Comma-separated fields to return, e.g. instanceId,outputs.value"
+    );
+
+    std::vector<crow::json::wvalue> listParameters = {
+        OpenAPIBuilder::createParameter(
+            "since",
+            "query",
+            false,
+            "integer",
+            "Only return nodes changed after this version (from X-Values-Version); "
+            "the response becomes {version, full, nodes, removed}. A version this server has not "
+            "issued (e.g. from before a restart) gets every node with full set"
+        ),
+        OpenAPIBuilder::createParameter(
+            "ids",
+            "query",
+            false,
+            "string",
+            "Comma-separated instance IDs to return"
+        ),
+        OpenAPIBuilder::createParameter(
+            "name",
+            "query",
+            false,
+            "string",
+            "Only return nodes with this nodeName"
+        ),
+        fieldsParam
+    };
+
+    apiBuilder.addEndpoint(
+        "/api/nodes/{instanceId}",
+        "GET",
+        "Get a single node",
+        crow::json::wvalue(),  // no request body
+        {{"200", {
+            {"description", "The node, in the same form as the GET /api/nodes items"},
+            {"content", {
+                {"application/json", {
+                    {"schema", {
+                        {"type", "object"}
+                    }}
+                }}
+            }}
+        }},
+         {"404", {{"description", "No node with this instance ID"}}}},
+        {instanceIdParam, fieldsParam}
+    );
+
     apiBuilder.addEndpoint(
         "/api/nodes",
         "GET",
@@ -210,94 +320,305 @@ class NodeRoutes {
                     }}
                 }}
             }}
-        }}}
+        }}},
+        listParameters
     );
   }
 
-  static crow::json::wvalue convertFlexValueToJson(const FlexValueCap::Reader& flex) {
-    if (flex.isIntVal()) {
-      return crow::json::wvalue(static_cast<std::int64_t>(flex.getIntVal()));
-    } else if (flex.isUintVal()) {
-      return crow::json::wvalue(static_cast<std::uint64_t>(flex.getUintVal()));
-    } else if (flex.isBoolVal()) {
-      return crow::json::wvalue(flex.getBoolVal());
-    } else if (flex.isDoubleVal()) {
-      return crow::json::wvalue(flex.getDoubleVal());
-    } else if (flex.isStringVal()) {
-      return crow::json::wvalue(std::string(flex.getStringVal().cStr()));
+  static bool parseUint(const char* text, uint64_t& value) {
+    const char* end = text + strlen(text);
+    auto result = std::from_chars(text, end, value);
+    return result.ec == std::errc() && result.ptr == end && result.ptr != text;
+  }
+
+  // Compiled plan for ?fields=, the full projection when absent, or null when
+  // a field name is unknown.
+  static std::shared_ptr<const NodeProjection> projectionFor(const crow::request& req) {
+    const char* fields = req.url_params.get("fields");
+    if (fields == nullptr) {
+      return std::shared_ptr<const NodeProjection>(std::shared_ptr<const NodeProjection>(), &NodeProjection::all());
     }
-    return crow::json::wvalue(nullptr);
+    return NodeProjection::compile(fields);
   }
 
-  static crow::json::wvalue convertIOToJson(const IO::Reader& io) {
-    crow::json::wvalue json;
-    json["name"] = std::string(io.getName().cStr());
-    json["value"] = convertFlexValueToJson(io.getValue());
-    json["override"] = io.getOverride();
-    json["override_value"] = convertFlexValueToJson(io.getOverrideValue());
-    json["default_value"] = convertFlexValueToJson(io.getDefaultValue());
-    return json;
+  enum class Representation {
+    JSON,
+    CAPNP,
+    CBOR,
+    MSGPACK,
+  };
+
+  // The representation of GET /api/nodes and /api/nodes/<id> that the Accept
+  // header prefers; JSON when it accepts none of them.
+  static Representation representationFor(const crow::request& req) {
+    switch (HttpHeaders::preferred(req.get_header_value("Accept"),
+                                   {"application/json", CapnpBody::CONTENT_TYPE, "application/cbor",
+                                    "application/msgpack", "application/x-msgpack"})) {
+      case 1: return Representation::CAPNP;
+      case 2: return Representation::CBOR;
+      case 3:
+      case 4: return Representation::MSGPACK;
+      default: return Representation::JSON;
+    }
   }
-  static crow::json::wvalue convertOutputIOToJson(const IO::Reader& io) {
-    crow::json::wvalue json;
-    json["name"] = std::string(io.getName().cStr());
-    json["value"] = convertFlexValueToJson(io.getValue());
-    json["override"] = io.getOverride();
-    json["override_value"] = convertFlexValueToJson(io.getOverrideValue());
-    json["fallback_value"] = convertFlexValueToJson(io.getDefaultValue());  // renamed for outputs
-    return json;
+
+  static std::optional<NodeBinaryWriter::Format> binaryFormat(Representation representation) {
+    switch (representation) {
+      case Representation::CBOR: return NodeBinaryWriter::Format::CBOR;
+      case Representation::MSGPACK: return NodeBinaryWriter::Format::MSGPACK;
+      default: return std::nullopt;
+    }
   }
 
-  static crow::json::wvalue convertNodeToJson(const Node::Reader& node) {
-    crow::json::wvalue json;
-    json["instanceId"] = static_cast<uint32_t>(node.getInstanceId());
-    json["nodeName"] = std::string(node.getNodeName().cStr());
-    json["hasChildren"] = node.getHasChildren();
-
-    // Add NodeStatus
-    auto nodeStatus = node.getNodeStatus();
-    json["nodeStatus"]["status"] = std::string(nodeStatus.getStatus().cStr());
-    json["nodeStatus"]["count"] = static_cast<uint32_t>(nodeStatus.getCount());
-    json["nodeStatus"]["duration"] = static_cast<uint32_t>(nodeStatus.getDuration());
-
-    json["inputs"] = crow::json::wvalue::list();
-    auto inputs = node.getInputs();
-    for (size_t i = 0; i < inputs.size(); i++) {
-      json["inputs"][i] = convertIOToJson(inputs[i]);
+  // Node positions picked by ?ids=1,2,3 and/or ?name=, looked up through the
+  // snapshot indexes. Returns false on a malformed ids list; leaves
+  // `selection` empty when neither parameter is given.
+  static bool selectNodes(const crow::request& req, const NodeSnapshotCache::Snapshot& snapshot,
+                          std::optional<std::vector<uint32_t>>& selection) {
+    const char* ids = req.url_params.get("ids");
+    const char* name = req.url_params.get("name");
+
+    if (ids != nullptr) {
+      selection.emplace();
+      const char* end = ids + strlen(ids);
+      for (const char* pos = ids; pos < end;) {
+        uint32_t instanceId;
+        auto result = std::from_chars(pos, end, instanceId);
+        if (result.ec != std::errc() || (result.ptr != end && *result.ptr != ',')) {
+          return false;
+        }
+        auto found = snapshot.indexById.find(instanceId);
+        if (found != snapshot.indexById.end()) {
+          selection->push_back(found->second);
+        }
+        pos = result.ptr + 1;
+      }
+    }
+
+    if (name != nullptr) {
+      auto found = snapshot.indexByName.find(std::string_view(name));
+      std::vector<uint32_t> named;
+      if (found != snapshot.indexByName.end()) {
+        named = found->second;
+      }
+      if (selection) {
+        auto& byId = *selection;
+        byId.erase(std::remove_if(byId.begin(), byId.end(), [&named](uint32_t index) {
+          return std::find(named.begin(), named.end(), index) == named.end();
+        }), byId.end());
+      } else {
+        selection = std::move(named);
+      }
+    }
+    return true;
+  }
+
+  static std::string writeSelected(const NodeSnapshotCache::Snapshot& snapshot, const std::vector<uint32_t>& selection,
+                                   const NodeProjection& projection) {
+    auto nodes = snapshot.message.get().getNodes();
+    std::string body;
+    NodeJsonWriter writer(body);
+    writer.writeRaw("[");
+    for (size_t i = 0; i < selection.size(); i++) {
+      if (i > 0) {
+        writer.writeRaw(",");
+      }
+      writer.writeNode(nodes[selection[i]], projection);
+    }
+    writer.writeRaw("]");
+    return body;
+  }
+
+  // The selected nodes as a GetAllValuesResults of their own.
+  static crow::response writeSelectedCapnp(const NodeSnapshotCache::Snapshot& snapshot,
+                                           const std::vector<uint32_t>& selection) {
+    auto nodes = snapshot.message.get().getNodes();
+    capnp::MallocMessageBuilder message;
+    auto list = message.initRoot<Engine::GetAllValuesResults>().initNodes(selection.size());
+    for (size_t i = 0; i < selection.size(); i++) {
+      list.setWithCaveats(i, nodes[selection[i]]);
+    }
+    return CapnpBody::respond(message);
+  }
+
+  // Runs a value write whose body is the engine's own Set*Params struct, as
+  // sent or as parsed from JSON by parseJson. The instance ID in the path wins
+  // over the one in the body. write returns an empty string once it has sent
+  // the write, or why it refused to.
+  template <typename T, typename Parse, typename Func>
+  static crow::response writeValue(const crow::request& req, NodeSnapshotCache& snapshots,
+                                   Parse&& parseJson, Func&& write) {
+    try {
+      std::string invalid;
+      auto error = CapnpBody::readOrParse<T>(req, parseJson, [&](typename T::Reader params) { invalid = write(params); });
+      if (error)
+        return std::move(*error);
+      if (!invalid.empty())
+        return crow::response(400, invalid);
+      snapshots.invalidate();
+      return crow::response(200);
+    } catch (const std::exception& e) {
+      return crow::response(500, e.what());
+    }
+  }
+
+  // What GET /api/nodes?since= reports: positions of nodes changed after
+  // `since` and instance IDs removed after it. If `since` predates the
+  // removal log, or is ahead of the current version (versions restart with
+  // the process), every node is listed and `full` is set so the client can
+  // drop nodes it no longer sees. A selection narrows the nodes listed;
+  // removals are always reported.
+  struct Changes {
+    bool full;
+    std::vector<uint32_t> nodes;
+    std::vector<uint32_t> removed;
+  };
+
+  static Changes changesSince(const NodeSnapshotCache::Snapshot& snapshot, uint64_t since,
+                              const std::optional<std::vector<uint32_t>>& selection) {
+    Changes changes{since < snapshot.removedFloor || since > snapshot.version, {}, {}};
+    auto count = selection ? selection->size() : snapshot.message.get().getNodes().size();
+    for (size_t n = 0; n < count; n++) {
+      uint32_t i = selection ? (*selection)[n] : n;
+      if (changes.full || snapshot.versions[i].node > since) {
+        changes.nodes.push_back(i);
+      }
+    }
+    for (auto& [version, instanceId] : snapshot.removed) {
+      if (!changes.full && version > since) {
+        changes.removed.push_back(instanceId);
+      }
     }
+    return changes;
+  }
 
-    json["outputs"] = crow::json::wvalue::list();
-    auto outputs = node.getOutputs();
-    for (size_t i = 0; i < outputs.size(); i++) {
-      json["outputs"][i] = convertOutputIOToJson(outputs[i]);
+  // {"version", "full", "nodes", "removed"}; see changesSince.
+  static std::string writeChangesSince(const NodeSnapshotCache::Snapshot& snapshot, const Changes& changes,
+                                       const NodeProjection& projection) {
+    auto nodes = snapshot.message.get().getNodes();
+    std::string body;
+    NodeJsonWriter writer(body);
+    writer.writeRaw("{\"version\":");
+    writer.writeUint(snapshot.version);
+    writer.writeRaw(",\"full\":");
+    writer.writeBool(changes.full);
+    writer.writeRaw(",\"nodes\":[");
+    for (size_t i = 0; i < changes.nodes.size(); i++) {
+      if (i > 0) {
+        writer.writeRaw(",");
+      }
+      writer.writeNode(nodes[changes.nodes[i]], projection);
+    }
+    writer.writeRaw("],\"removed\":[");
+    for (size_t i = 0; i < changes.removed.size(); i++) {
+      if (i > 0) {
+        writer.writeRaw(",");
+      }
+      writer.writeUint(changes.removed[i]);
     }
+    writer.writeRaw("]}");
+    return body;
+  }
 
-    return json;
+  // GET /api/nodes as CBOR or MessagePack, in the same shapes as the JSON.
+  static std::string writeBinary(NodeBinaryWriter::Format format, const NodeSnapshotCache::Snapshot& snapshot,
+                                 const std::optional<Changes>& changes,
+                                 const std::optional<std::vector<uint32_t>>& selection,
+                                 const NodeProjection& projection) {
+    auto nodes = snapshot.message.get().getNodes();
+    std::string body;
+    NodeBinaryWriter writer(body, format);
+    if (changes) {
+      writer.writeMap(4);
+      writer.writeKey("version");
+      writer.writeUint(snapshot.version);
+      writer.writeKey("full");
+      writer.writeBool(changes->full);
+      writer.writeKey("nodes");
+      writer.writeArray(changes->nodes.size());
+      for (uint32_t i : changes->nodes) {
+        writer.writeNode(nodes[i], projection);
+      }
+      writer.writeKey("removed");
+      writer.writeArray(changes->removed.size());
+      for (uint32_t instanceId : changes->removed) {
+        writer.writeUint(instanceId);
+      }
+    } else if (selection) {
+      writer.writeArray(selection->size());
+      for (uint32_t i : *selection) {
+        writer.writeNode(nodes[i], projection);
+      }
+    } else {
+      writer.writeNodes(nodes, projection);
+    }
+    return body;
   }
 
+  // Returns an empty string on success, otherwise what is wrong with the
+  // entry.
+  static std::string parseValueWrite(const crow::json::rvalue& x, EngineService::ValueWrite& write) {
+    using crow::json::type;
+    if (x.t() != type::Object || !x.has("instanceId") || x["instanceId"].t() != type::Number ||
+        !x.has("name") || x["name"].t() != type::String || !x.has("kind") || x["kind"].t() != type::String)
+      return "requires 'instanceId', 'name' and 'kind'";
+    if (!x.has("value") || (x["value"].t() != type::Number && x["value"].t() != type::String &&
+                            x["value"].t() != type::True && x["value"].t() != type::False))
+      return "'value' must be a number, string or boolean";
+
+    std::string kind = x["kind"].s();
+    if (kind == "default") {
+      write.kind = EngineService::ValueWrite::Kind::DEFAULT;
+    } else if (kind == "fallback") {
+      write.kind = EngineService::ValueWrite::Kind::FALLBACK;
+    } else if (kind == "override") {
+      write.kind = EngineService::ValueWrite::Kind::OVERRIDE;
+      if (!x.has("duration"))
+        return "override requires 'duration'";
+      auto error = JsonBodyParser::uint32Field(x, "duration", write.duration);
+      if (!error.empty())
+        return error;
+      write.active = x.has("active") && x["active"].t() == type::True;
+      write.input = x.has("input") && x["input"].t() == type::True;
+    } else {
+      return "unknown kind '" + kind + "'";
+    }
+    auto error = JsonBodyParser::uint32Field(x, "instanceId", write.instance_id);
+    if (!error.empty())
+      return error;
+    write.name = x["name"].s();
+    write.value = x["value"];
+    return std::string();
+  }
 
-  static void setupRoutes(crow::App<crow::CORSHandler>& app, EngineService& engineService) {
+  static void setupRoutes(RestApp& app, EngineService& engineService,
+                          NodeSnapshotCache& snapshots, PositionCoalescer& positions) {
     CROW_ROUTE(app, "/api/nodes")
         .methods("POST"_method)
-            ([&engineService](const crow::request& req) {
-              auto x = crow::json::load(req.body);
-              if (!x)
-                return crow::response(400, "Invalid JSON");
-
+            ([&engineService, &snapshots](const crow::request& req) {
               try {
-                auto [instanceId, name] = engineService.AddNode(
-                    x["packageId"].u(),
-                    x["nodeId"].u(),
-                    x["parentId"].u(),
-                    x["posX"].u(),
-                    x["posY"].u()
-                );
+                uint32_t instanceId;
+                std::string name;
+                auto error = CapnpBody::readOrParse<NodeDetails>(req, JsonBodyParser::nodeDetails,
+                                                                 [&](NodeDetails::Reader details) {
+                  std::tie(instanceId, name) = engineService.AddNode(details);
+                });
+                if (error)
+                  return std::move(*error);
+                snapshots.invalidate();
+
+                if (CapnpBody::accepted(req)) {
+                  return CapnpBody::build<Engine::AddNodeResults>([&](Engine::AddNodeResults::Builder results) {
+                    results.setInstanceId(instanceId);
+                    results.setName(name);
+                  });
+                }
 
                 crow::json::wvalue response;
                 response["instanceId"] = instanceId;
                 response["name"] = name;
 
-                return crow::response(response);
+                return CapnpBody::json(response);
               } catch (const std::exception& e) {
                 return crow::response(500, e.what());
               }
@@ -305,38 +626,63 @@ class NodeRoutes {
 
     CROW_ROUTE(app, "/api/nodes")
         .methods("PUT"_method)
-            ([&engineService](const crow::request& req) {
-              auto x = crow::json::load(req.body);
-              if (!x)
-                return crow::response(400, "Invalid JSON");
+            ([&snapshots, &positions](const crow::request& req) {
+              uint32_t instanceId;
+              int32_t posX, posY;
+              auto error = CapnpBody::readOrParse<NodeDetails>(req, JsonBodyParser::nodePosition,
+                                                               [&](NodeDetails::Reader details) {
+                instanceId = details.getInstanceId();
+                posX = details.getPosX();
+                posY = details.getPosY();
+              });
+              if (error)
+                return std::move(*error);
+
+              // Acknowledged before it reaches the engine; see PositionCoalescer.
+              positions.submit(instanceId, posX, posY);
+
+              std::string name;
+              if (auto snapshot = snapshots.latest()) {
+                auto found = snapshot->indexById.find(instanceId);
+                if (found != snapshot->indexById.end()) {
+                  name = snapshot->message.get().getNodes()[found->second].getNodeName().cStr();
+                }
+              }
 
-              try {
-                auto [instanceId, name] = engineService.UpdateNode(
-                    x["instanceId"].u(),
-                    x["posX"].u(),
-                    x["posY"].u()
-                );
+              if (CapnpBody::accepted(req)) {
+                return CapnpBody::build<Engine::UpdateNodeResults>([&](Engine::UpdateNodeResults::Builder results) {
+                  results.setInstanceId(instanceId);
+                  results.setName(name);
+                }, 202);
+              }
 
-                crow::json::wvalue response;
-                response["instanceId"] = instanceId;
+              crow::json::wvalue response;
+              response["instanceId"] = instanceId;
+              if (!name.empty()) {
                 response["name"] = name;
-
-                return crow::response(response);
-              } catch (const std::exception& e) {
-                return crow::response(500, e.what());
               }
+
+              return CapnpBody::json(response, 202);
             });
 
     CROW_ROUTE(app, "/api/nodes/<uint>")
         .methods("DELETE"_method)
-            ([&engineService](uint32_t instanceId) {
+            ([&engineService, &snapshots, &positions](const crow::request& req, uint32_t instanceId) {
               try {
+                positions.drop(instanceId);
                 auto resultId = engineService.removeNode(instanceId);
+                snapshots.invalidate();
+
+                if (CapnpBody::accepted(req)) {
+                  return CapnpBody::build<Engine::RemoveNodeResults>([&](Engine::RemoveNodeResults::Builder results) {
+                    results.setInstanceId(resultId);
+                  });
+                }
 
                 crow::json::wvalue response;
                 response["instanceId"] = resultId;
 
-                return crow::response(response);
+                return CapnpBody::json(response);
               } catch (const std::exception& e) {
                 return crow::response(500, e.what());
               }
@@ -344,76 +690,201 @@ class NodeRoutes {
 
     CROW_ROUTE(app, "/api/nodes")
         .methods("GET"_method)
-            ([&engineService]() {
-              try {
-                capnp::EzRpcClient client(kj::str("unix:", "/tmp/engine-socket").cStr());
-                Engine::Client engine = client.getMain<Engine>();
+            ([&snapshots](const crow::request& req) {
+              uint64_t since = 0;
+              const char* sinceParam = req.url_params.get("since");
+              if (sinceParam != nullptr && !parseUint(sinceParam, since))
+                return crow::response(400, "Invalid 'since' version");
+
+              auto projection = projectionFor(req);
+              if (!projection)
+                return crow::response(400, "Invalid 'fields'");
 
-                auto request = engine.getAllValuesRequest();
-                auto response = request.send().wait(client.getWaitScope());
-                auto nodes = response.getNodes();
+              try {
+                auto snapshot = snapshots.get();
+
+                std::optional<std::vector<uint32_t>> selection;
+                if (!selectNodes(req, *snapshot, selection))
+                  return crow::response(400, "Invalid 'ids'. Expected a comma-separated list of instance IDs");
+
+                auto representation = representationFor(req);
+                if (representation == Representation::CAPNP) {
+                  if (sinceParam != nullptr || req.url_params.get("fields") != nullptr)
+                    return crow::response(406, "'since' and 'fields' are only available as JSON");
+                  auto resp = selection ? writeSelectedCapnp(*snapshot, *selection)
+                                        : CapnpBody::respond(snapshot->message);
+                  resp.set_header("X-Values-Version", std::to_string(snapshot->version));
+                  return resp;
+                }
 
-                crow::json::wvalue result;
-                for (size_t i = 0; i < nodes.size(); i++) {
-                  result[i] = convertNodeToJson(nodes[i]);
+                std::optional<Changes> changes;
+                if (sinceParam != nullptr) {
+                  changes = changesSince(*snapshot, since, selection);
                 }
 
-                return crow::response(result);
+                crow::response resp;
+                resp.add_header("Vary", "Accept");
+                if (auto format = binaryFormat(representation)) {
+                  resp.body = writeBinary(*format, *snapshot, changes, selection, *projection);
+                  resp.set_header("Content-Type", NodeBinaryWriter::contentType(*format));
+                  resp.set_header("X-Values-Version", std::to_string(snapshot->version));
+                  return resp;
+                }
+                if (changes) {
+                  resp.body = writeChangesSince(*snapshot, *changes, *projection);
+                } else if (selection) {
+                  resp.body = writeSelected(*snapshot, *selection, *projection);
+                } else if (projection.get() != &NodeProjection::all()) {
+                  NodeJsonWriter(resp.body).writeNodes(snapshot->message.get().getNodes(), *projection);
+                } else {
+                  resp.body = snapshot->json;
+                }
+                resp.set_header("Content-Type", "application/json");
+                resp.set_header("X-Values-Version", std::to_string(snapshot->version));
+                return resp;
               } catch (const std::exception& e) {
                 return crow::response(500, e.what());
               }
             });
 
-    CROW_ROUTE(app, "/api/nodes/<uint>/default")
-        .methods("PUT"_method)
-            ([&engineService](const crow::request& req, uint32_t instance_id) {
-              auto x = crow::json::load(req.body);
-              if (!x || !x.has("name") || !x.has("value"))
-                return crow::response(400, "Invalid JSON. Required fields: 'name' and 'value'");
+    CROW_ROUTE(app, "/api/nodes/<uint>")
+        .methods("GET"_method)
+            ([&snapshots](const crow::request& req, uint32_t instanceId) {
+              auto projection = projectionFor(req);
+              if (!projection)
+                return crow::response(400, "Invalid 'fields'");
 
               try {
-                engineService.SetDefault(instance_id, x["name"].s(), x["value"]);
-                return crow::response(200);
+                auto snapshot = snapshots.get();
+                auto found = snapshot->indexById.find(instanceId);
+                if (found == snapshot->indexById.end())
+                  return crow::response(404, "Node not found");
+
+                auto representation = representationFor(req);
+                if (representation == Representation::CAPNP) {
+                  if (req.url_params.get("fields") != nullptr)
+                    return crow::response(406, "'fields' is only available as JSON");
+                  capnp::MallocMessageBuilder message;
+                  message.setRoot(snapshot->message.get().getNodes()[found->second]);
+                  auto resp = CapnpBody::respond(message);
+                  resp.set_header("X-Values-Version", std::to_string(snapshot->version));
+                  return resp;
+                }
+
+                auto node = snapshot->message.get().getNodes()[found->second];
+                std::string body;
+                auto format = binaryFormat(representation);
+                if (format) {
+                  NodeBinaryWriter(body, *format).writeNode(node, *projection);
+                } else {
+                  NodeJsonWriter(body).writeNode(node, *projection);
+                }
+
+                crow::response resp(std::move(body));
+                resp.set_header("Content-Type", format ? NodeBinaryWriter::contentType(*format) : "application/json");
+                resp.add_header("Vary", "Accept");
+                resp.set_header("X-Values-Version", std::to_string(snapshot->version));
+                return resp;
               } catch (const std::exception& e) {
                 return crow::response(500, e.what());
               }
             });
 
-    CROW_ROUTE(app, "/api/nodes/<uint>/override")
+    CROW_ROUTE(app, "/api/nodes/values/batch")
         .methods("PUT"_method)
-            ([&engineService](const crow::request& req, uint32_t instance_id) {
-              auto x = crow::json::load(req.body);
-              if (!x || !x.has("name") || !x.has("value") || !x.has("duration"))
-                return crow::response(400, "Invalid JSON. Required fields: 'name', 'value', and 'duration'");
+            ([&engineService, &snapshots](const crow::request& req) {
+              auto x = Metrics::global().timeJsonParse([&req]() { return crow::json::load(req.body); });
+              if (!x || x.t() != crow::json::type::List)
+                return crow::response(400, "Invalid JSON. Expected an array of value writes");
+
+              // Entries that fail validation, including IO names the node
+              // does not have, are reported and not sent; the rest go to the
+              // engine together.
+              std::vector<EngineService::ValueWriteResult> results(x.size());
+              std::vector<EngineService::ValueWrite> writes;
+              std::vector<size_t> positions;
+              writes.reserve(x.size());
+              for (size_t i = 0; i < x.size(); i++) {
+                EngineService::ValueWrite write;
+                results[i].error = parseValueWrite(x[i], write);
+                if (results[i].error.empty()) {
+                  bool input = write.kind == EngineService::ValueWrite::Kind::DEFAULT ||
+                      (write.kind == EngineService::ValueWrite::Kind::OVERRIDE && write.input);
+                  results[i].error = snapshots.checkIO(write.instance_id, write.name, input);
+                }
+                if (results[i].error.empty()) {
+                  writes.push_back(std::move(write));
+                  positions.push_back(i);
+                }
+              }
 
               try {
-                engineService.SetOverride(
-                    instance_id,
-                    x["name"].s(),
-                    x["value"],
-                    x["duration"].u(),
-                    x["active"].b(),
-                    x["input"].b()
-                );
-                return crow::response(200);
+                if (!writes.empty()) {
+                  auto sent = engineService.ApplyValueBatch(writes);
+                  snapshots.invalidate();
+                  for (size_t i = 0; i < sent.size(); i++) {
+                    results[positions[i]] = std::move(sent[i]);
+                  }
+                }
+
+                crow::json::wvalue response;
+                response["results"] = crow::json::wvalue::list();
+                for (size_t i = 0; i < results.size(); i++) {
+                  auto& json = response["results"][i];
+                  json["ok"] = results[i].ok;
+                  if (!results[i].ok) {
+                    json["error"] = results[i].error;
+                  }
+                }
+                return crow::response(response);
               } catch (const std::exception& e) {
                 return crow::response(500, e.what());
               }
             });
 
-    CROW_ROUTE(app, "/api/nodes/<uint>/fallback")
+    CROW_ROUTE(app, "/api/nodes/<uint>/default")
         .methods("PUT"_method)
-            ([&engineService](const crow::request& req, uint32_t instance_id) {
-              auto x = crow::json::load(req.body);
-              if (!x || !x.has("name") || !x.has("value"))
-                return crow::response(400, "Invalid JSON. Required fields: 'name' and 'value'");
+            ([&engineService, &snapshots](const crow::request& req, uint32_t instance_id) {
+              return writeValue<Engine::SetDefaultParams>(req, snapshots,
+                  [](const std::string& body, Engine::SetDefaultParams::Builder params) {
+                    return JsonBodyParser::io(body, params.getDefault());
+                  },
+                  [&](Engine::SetDefaultParams::Reader params) {
+                    auto io = params.getDefault();
+                    auto invalid = snapshots.checkIO(instance_id, io.getName().cStr(), true);
+                    if (invalid.empty())
+                      engineService.SetDefault(instance_id, io);
+                    return invalid;
+                  });
+            });
 
-              try {
-                engineService.SetFallback(instance_id, x["name"].s(), x["value"]);
-                return crow::response(200);
-              } catch (const std::exception& e) {
-                return crow::response(500, e.what());
-              }
+    CROW_ROUTE(app, "/api/nodes/<uint>/override")
+        .methods("PUT"_method)
+            ([&engineService, &snapshots](const crow::request& req, uint32_t instance_id) {
+              return writeValue<Engine::SetOverrideParams>(req, snapshots, JsonBodyParser::override,
+                  [&](Engine::SetOverrideParams::Reader params) {
+                    auto io = params.getOverride();
+                    auto invalid = snapshots.checkIO(instance_id, io.getName().cStr(), params.getInput());
+                    if (invalid.empty())
+                      engineService.SetOverride(instance_id, io, params.getDuration(), params.getActive(), params.getInput());
+                    return invalid;
+                  });
+            });
+
+    CROW_ROUTE(app, "/api/nodes/<uint>/fallback")
+        .methods("PUT"_method)
+            ([&engineService, &snapshots](const crow::request& req, uint32_t instance_id) {
+              return writeValue<Engine::SetFallbackParams>(req, snapshots,
+                  [](const std::string& body, Engine::SetFallbackParams::Builder params) {
+                    return JsonBodyParser::io(body, params.getFallback());
+                  },
+                  [&](Engine::SetFallbackParams::Reader params) {
+                    auto io = params.getFallback();
+                    auto invalid = snapshots.checkIO(instance_id, io.getName().cStr(), false);
+                    if (invalid.empty())
+                      engineService.SetFallback(instance_id, io);
+                    return invalid;
+                  });
             });
 
 
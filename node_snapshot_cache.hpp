@@ -0,0 +1,266 @@
+//
+// Created by craig on 17/10/2026.
+//
+
+#ifndef NODE_SNAPSHOT_CACHE_HPP_
+#define NODE_SNAPSHOT_CACHE_HPP_
+
+#include <chrono>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+#include "engine_service.hpp"
+#include "io_name_table.hpp"
+#include "node_json_writer.hpp"
+#include "node_values.hpp"
+
+// Last getAllValues result and its JSON, shared by every GET /api/nodes.
+// A snapshot is reused until it is older than maxAge or a write through this
+// API invalidates it; concurrent pollers that find it stale wait on a single
+// refresh instead of each calling the engine.
+//
+// Each refresh is compared with the one before it to stamp nodes and IOs
+// with the version they last changed at, for GET /api/nodes?since=.
+class NodeSnapshotCache {
+ public:
+  // Snapshot version at which each part of a node last changed.
+  struct NodeVersions {
+    uint64_t node = 0;  // newest of the entries below
+    uint64_t status = 0;
+    std::vector<uint64_t> inputs;
+    std::vector<uint64_t> outputs;
+  };
+
+  struct Snapshot {
+    explicit Snapshot(EngineMessage<Engine::GetAllValuesResults>&& message) : message(std::move(message)) {}
+
+    EngineMessage<Engine::GetAllValuesResults> message;
+    std::string json;
+    std::chrono::steady_clock::time_point taken;
+    uint64_t generation = 0;
+
+    // Bumped only when a refresh sees a value, override or status change.
+    uint64_t version = 0;
+    std::vector<NodeVersions> versions;  // parallel to message nodes
+    // Positions in the node list, for point lookups.
+    std::unordered_map<uint32_t, uint32_t> indexById;
+    std::unordered_map<std::string_view, std::vector<uint32_t>> indexByName;  // views into message
+    IoNameTable ioNames;
+    // (version, instanceId) of recently removed nodes; removals older than
+    // removedFloor have been dropped from the log.
+    std::vector<std::pair<uint64_t, uint32_t>> removed;
+    uint64_t removedFloor = 0;
+  };
+
+  static constexpr size_t MAX_REMOVED = 1024;
+
+  NodeSnapshotCache(EngineService& engineService, std::chrono::milliseconds maxAge)
+      : engineService(engineService), maxAge(maxAge) {}
+
+  std::shared_ptr<const Snapshot> get() {
+    std::unique_lock<std::mutex> lock(mutex);
+    if (current && current->generation == generation &&
+        std::chrono::steady_clock::now() - current->taken < maxAge) {
+      return current;
+    }
+    // A refresh that started before the latest write may not see it.
+    if (pending.valid() && pendingGeneration == generation) {
+      auto refresh = pending;
+      lock.unlock();
+      return refresh.get();
+    }
+
+    std::promise<std::shared_ptr<const Snapshot>> result;
+    pending = result.get_future().share();
+    auto refresh = pending;
+    uint64_t startGeneration = generation;
+    pendingGeneration = startGeneration;
+    lock.unlock();
+
+    try {
+      auto snapshot = std::make_shared<Snapshot>(engineService.GetAllNodes());
+      snapshot->taken = std::chrono::steady_clock::now();
+      snapshot->generation = startGeneration;
+      snapshot->json.reserve(snapshot->message.sizeInBytes() * 3);
+      NodeJsonWriter(snapshot->json).writeNodes(snapshot->message.get().getNodes());
+      Metrics::global().snapshotSerialize().observe(std::chrono::duration_cast<std::chrono::microseconds>(
+          std::chrono::steady_clock::now() - snapshot->taken).count());
+
+      buildIndexes(*snapshot);
+
+      lock.lock();
+      // A refresh that started after a later write may already have finished;
+      // its snapshot is newer, so its waiters get that one.
+      std::shared_ptr<const Snapshot> published = current;
+      if (!current || current->generation <= startGeneration) {
+        trackVersions(current.get(), *snapshot);
+        current = published = snapshot;
+      }
+      if (pendingGeneration == startGeneration) {
+        pending = {};
+      }
+      lock.unlock();
+      result.set_value(std::move(published));
+    } catch (...) {
+      lock.lock();
+      if (pendingGeneration == startGeneration) {
+        pending = {};
+      }
+      lock.unlock();
+      result.set_exception(std::current_exception());
+    }
+    return refresh.get();
+  }
+
+  // The newest snapshot without refreshing it, or null before the first get().
+  std::shared_ptr<const Snapshot> latest() {
+    std::lock_guard<std::mutex> lock(mutex);
+    return current;
+  }
+
+  // Called after a write so the next read goes back to the engine.
+  void invalidate() {
+    std::lock_guard<std::mutex> lock(mutex);
+    generation++;
+  }
+
+  // Checks that instanceId has an input (or output) called `name`, against
+  // the newest snapshot and without refreshing it. Only a snapshot that is
+  // current (no write since it was taken, and within maxAge) can reject;
+  // otherwise, or if it has no such node, the write goes to the engine to
+  // decide. Returns an empty string if it may go ahead, otherwise what is
+  // wrong.
+  std::string checkIO(uint32_t instanceId, std::string_view name, bool input) {
+    std::shared_ptr<const Snapshot> snapshot;
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      if (current && current->generation == generation &&
+          std::chrono::steady_clock::now() - current->taken < maxAge) {
+        snapshot = current;
+      }
+    }
+    if (!snapshot) {
+      return std::string();
+    }
+    auto found = snapshot->indexById.find(instanceId);
+    if (found == snapshot->indexById.end() || snapshot->ioNames.has(found->second, name, input)) {
+      return std::string();
+    }
+    return "node " + std::to_string(instanceId) + " has no " + (input ? "input" : "output") +
+        " named '" + std::string(name) + "'";
+  }
+
+  // Bumped by every invalidate(), i.e. by every write through this API.
+  uint64_t revision() {
+    std::lock_guard<std::mutex> lock(mutex);
+    return generation;
+  }
+
+ private:
+  static uint64_t changedSince(IO::Reader before, uint64_t version, IO::Reader after, uint64_t next) {
+    return NodeValues::sameIO(before, after) ? version : next;
+  }
+
+  static void trackIOs(capnp::List<IO, capnp::Kind::STRUCT>::Reader before, const std::vector<uint64_t>& versions,
+                       capnp::List<IO, capnp::Kind::STRUCT>::Reader after, uint64_t next,
+                       std::vector<uint64_t>& out) {
+    out.resize(after.size());
+    for (uint32_t i = 0; i < after.size(); i++) {
+      out[i] = i < before.size() && i < versions.size()
+          ? changedSince(before[i], versions[i], after[i], next)
+          : next;
+    }
+  }
+
+  static void buildIndexes(Snapshot& snapshot) {
+    auto nodes = snapshot.message.get().getNodes();
+    snapshot.indexById.reserve(nodes.size());
+    for (uint32_t i = 0; i < nodes.size(); i++) {
+      auto name = nodes[i].getNodeName();
+      snapshot.indexById.emplace(nodes[i].getInstanceId(), i);
+      snapshot.indexByName[std::string_view(name.cStr(), name.size())].push_back(i);
+    }
+    snapshot.ioNames.build(nodes);
+  }
+
+  // Stamps every node and IO of `next` with the version it last changed at,
+  // comparing against `previous`. Runs under the mutex, so refreshes are
+  // versioned in the order they are published.
+  static void trackVersions(const Snapshot* previous, Snapshot& next) {
+    auto nodes = next.message.get().getNodes();
+    next.versions.resize(nodes.size());
+
+    if (previous == nullptr) {
+      next.version = 1;
+      for (uint32_t i = 0; i < nodes.size(); i++) {
+        auto& versions = next.versions[i];
+        versions.node = versions.status = next.version;
+        versions.inputs.assign(nodes[i].getInputs().size(), next.version);
+        versions.outputs.assign(nodes[i].getOutputs().size(), next.version);
+      }
+      return;
+    }
+
+    uint64_t candidate = previous->version + 1;
+    bool changed = false;
+    auto before = previous->message.get().getNodes();
+    for (uint32_t i = 0; i < nodes.size(); i++) {
+      auto node = nodes[i];
+      auto& versions = next.versions[i];
+      auto found = previous->indexById.find(node.getInstanceId());
+      if (found == previous->indexById.end()) {
+        versions.node = versions.status = candidate;
+        versions.inputs.assign(node.getInputs().size(), candidate);
+        versions.outputs.assign(node.getOutputs().size(), candidate);
+        changed = true;
+        continue;
+      }
+
+      auto old = before[found->second];
+      auto& oldVersions = previous->versions[found->second];
+      versions.status = NodeValues::sameStatus(old.getNodeStatus(), node.getNodeStatus())
+          ? oldVersions.status : candidate;
+      trackIOs(old.getInputs(), oldVersions.inputs, node.getInputs(), candidate, versions.inputs);
+      trackIOs(old.getOutputs(), oldVersions.outputs, node.getOutputs(), candidate, versions.outputs);
+
+      versions.node = versions.status;
+      for (auto version : versions.inputs) {
+        versions.node = std::max(versions.node, version);
+      }
+      for (auto version : versions.outputs) {
+        versions.node = std::max(versions.node, version);
+      }
+      changed = changed || versions.node == candidate;
+    }
+
+    next.removed = previous->removed;
+    next.removedFloor = previous->removedFloor;
+    for (auto old : before) {
+      if (next.indexById.find(old.getInstanceId()) == next.indexById.end()) {
+        next.removed.emplace_back(candidate, old.getInstanceId());
+        changed = true;
+      }
+    }
+    if (next.removed.size() > MAX_REMOVED) {
+      auto drop = next.removed.size() - MAX_REMOVED;
+      next.removedFloor = next.removed[drop - 1].first;
+      next.removed.erase(next.removed.begin(), next.removed.begin() + drop);
+    }
+
+    next.version = changed ? candidate : previous->version;
+  }
+
+  EngineService& engineService;
+  const std::chrono::milliseconds maxAge;
+
+  std::mutex mutex;
+  std::shared_ptr<const Snapshot> current;
+  std::shared_future<std::shared_ptr<const Snapshot>> pending;
+  uint64_t pendingGeneration = 0;  // generation the pending refresh started at
+  uint64_t generation = 0;
+};
+
+#endif //NODE_SNAPSHOT_CACHE_HPP_
@@ -0,0 +1,46 @@
+//
+// Created by craig on 17/10/2026.
+//
+
+#ifndef NODE_VALUES_HPP_
+#define NODE_VALUES_HPP_
+
+#include "schemas/package.capnp.h"
+
+// Value comparisons between two getAllValues snapshots.
+struct NodeValues {
+  static bool sameFlexValue(FlexValueCap::Reader a, FlexValueCap::Reader b) {
+    if (a.which() != b.which()) {
+      return false;
+    }
+    switch (a.which()) {
+      case FlexValueCap::INT_VAL:
+        return a.getIntVal() == b.getIntVal();
+      case FlexValueCap::UINT_VAL:
+        return a.getUintVal() == b.getUintVal();
+      case FlexValueCap::BOOL_VAL:
+        return a.getBoolVal() == b.getBoolVal();
+      case FlexValueCap::DOUBLE_VAL:
+        return a.getDoubleVal() == b.getDoubleVal();
+      case FlexValueCap::STRING_VAL:
+        return a.getStringVal() == b.getStringVal();
+    }
+    return true;
+  }
+
+  static bool sameIO(IO::Reader a, IO::Reader b) {
+    return a.getOverride() == b.getOverride() &&
+        a.getName() == b.getName() &&
+        sameFlexValue(a.getValue(), b.getValue()) &&
+        sameFlexValue(a.getOverrideValue(), b.getOverrideValue()) &&
+        sameFlexValue(a.getDefaultValue(), b.getDefaultValue());
+  }
+
+  static bool sameStatus(NodeStatus::Reader a, NodeStatus::Reader b) {
+    return a.getCount() == b.getCount() &&
+        a.getDuration() == b.getDuration() &&
+        a.getStatus() == b.getStatus();
+  }
+};
+
+#endif //NODE_VALUES_HPP_
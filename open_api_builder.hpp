@@ -5,10 +5,17 @@
 #ifndef OPEN_API_BUILDER_HPP_
 #define OPEN_API_BUILDER_HPP_
 
+#include "http_headers.hpp"
+
 class OpenAPIBuilder {
  private:
   crow::json::wvalue schema;
 
+  // Set by freeze(): the schema serialized once, without its leading '{',
+  // and a hash of it for ETags.
+  std::string frozen;
+  uint64_t frozenHash = 0;
+
 
  public:
   OpenAPIBuilder() {
@@ -17,10 +24,6 @@ class OpenAPIBuilder {
     schema["info"]["version"] = "1.0.0";
 
   }
-  void updateServerUrl(const std::string& url) {
-    schema["servers"][0]["url"] = url;
-    std::cout << url << std::endl;
-  }
 
 
   void addEndpoint(const std::string& path, const std::string& method,
@@ -28,6 +31,9 @@ class OpenAPIBuilder {
                    crow::json::wvalue requestBody = crow::json::wvalue(),
                    crow::json::wvalue responses = crow::json::wvalue(),
                    std::vector<crow::json::wvalue> parameters = std::vector<crow::json::wvalue>()) {
+    if (isFrozen()) {
+      throw std::logic_error("OpenAPIBuilder::addEndpoint called after freeze()");
+    }
     auto lowMethod = std::string(method);
     std::transform(lowMethod.begin(), lowMethod.end(), lowMethod.begin(), ::tolower);
 
@@ -79,8 +85,37 @@ class OpenAPIBuilder {
     return param;
   }
 
-  crow::json::wvalue getSchema() const {
-    return schema;
+  // Serializes the schema once, after every route has registered. The
+  // document can no longer be changed; document() and etag() serve it.
+  void freeze() {
+    std::string dumped = schema.dump();
+    frozen = dumped.substr(1);  // reopened by document() after "servers"
+    frozenHash = HttpHeaders::hash(frozen);
+  }
+
+  bool isFrozen() const {
+    return !frozen.empty();
+  }
+
+  // The frozen document with `servers` set to serverUrl, which depends on the
+  // request's Host header. The URL is spliced in ahead of the other members,
+  // so the tree is neither copied nor serialized again.
+  std::string document(const std::string& serverUrl) const {
+    std::string escaped;
+    crow::json::escape(serverUrl, escaped);
+
+    std::string out;
+    out.reserve(frozen.size() + escaped.size() + 32);
+    out += "{\"servers\":[{\"url\":\"";
+    out += escaped;
+    out += frozen.size() > 1 ? "\"}]," : "\"}]";
+    out += frozen;
+    return out;
+  }
+
+  // Strong ETag for document(serverUrl).
+  std::string etag(const std::string& serverUrl) const {
+    return HttpHeaders::strongETag(serverUrl, frozenHash);
   }
 };
 
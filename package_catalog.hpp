@@ -0,0 +1,172 @@
+//
+// Created by craig on 17/10/2026.
+//
+
+#ifndef PACKAGE_CATALOG_HPP_
+#define PACKAGE_CATALOG_HPP_
+
+#include <algorithm>
+#include <chrono>
+#include <future>
+#include <map>
+#include <memory>
+#include <mutex>
+#include "crow.h"
+#include "engine_service.hpp"
+#include "http_headers.hpp"
+
+// Package list and per-package JSON, cached for GET /api/packages. The
+// engine gives no notice when a package manager registers, so the list is
+// re-read at most once per `recheck`; package JSON is keyed by packageId and
+// packageVersion and fetched again only when the version set changes, all
+// changed packages at once. The getAvailablePackages message itself is kept,
+// and PackageDetails are read from its shared buffer. Only one refresh runs
+// at a time; requests that arrive during the first load wait for it.
+class PackageCatalog {
+ public:
+  struct Document {
+    std::string json;
+    std::string etag;  // strong, quoted
+  };
+
+  struct Catalog {
+    explicit Catalog(EngineMessage<Engine::GetAvailablePackagesResults> message) : message(std::move(message)) {}
+
+    EngineMessage<Engine::GetAvailablePackagesResults> message;
+    Document list;
+    std::map<uint32_t, std::shared_ptr<const Document>> json;  // by packageId
+  };
+
+  PackageCatalog(EngineService& engineService, std::chrono::milliseconds recheck)
+      : engineService(engineService), recheck(recheck) {}
+
+  std::shared_ptr<const Catalog> get() {
+    std::unique_lock<std::mutex> lock(mutex);
+    // Once loaded, the cached list is served while a refresh is under way.
+    if (current && (pending.valid() || std::chrono::steady_clock::now() - checked < recheck)) {
+      return current;
+    }
+    // The first load is shared by every request that arrives before it ends.
+    if (pending.valid()) {
+      auto loading = pending;
+      lock.unlock();
+      return loading.get();
+    }
+
+    std::promise<std::shared_ptr<const Catalog>> result;
+    pending = result.get_future().share();
+    auto loading = pending;
+    auto previous = current;
+    lock.unlock();
+
+    try {
+      auto next = refresh(previous);
+      lock.lock();
+      current = next;
+      checked = std::chrono::steady_clock::now();
+      pending = {};
+      lock.unlock();
+      result.set_value(std::move(next));
+    } catch (...) {
+      lock.lock();
+      pending = {};
+      auto cached = current;
+      if (cached) {
+        // Retried after another `recheck`, not on the next request.
+        checked = std::chrono::steady_clock::now();
+      }
+      lock.unlock();
+      if (cached) {
+        CROW_LOG_WARNING << "Package list refresh failed; serving the cached list";
+        result.set_value(std::move(cached));
+      } else {
+        result.set_exception(std::current_exception());
+      }
+    }
+    return loading.get();
+  }
+
+  // Null if the engine does not list packageId or its JSON could not be
+  // fetched.
+  std::shared_ptr<const Document> json(uint32_t packageId) {
+    auto catalog = get();
+    auto found = catalog->json.find(packageId);
+    return found == catalog->json.end() ? nullptr : found->second;
+  }
+
+ private:
+  EngineService& engineService;
+  const std::chrono::milliseconds recheck;
+
+  std::mutex mutex;
+  std::shared_ptr<const Catalog> current;
+  std::chrono::steady_clock::time_point checked;
+  std::shared_future<std::shared_ptr<const Catalog>> pending;  // refresh under way, if any
+
+  std::shared_ptr<const Catalog> refresh(const std::shared_ptr<const Catalog>& previous) {
+    auto message = engineService.GetAvailablePackages();
+    auto packages = message.get().getAvailablePackages();
+
+    if (previous && samePackages(previous->message.get().getAvailablePackages(), packages)) {
+      return previous;
+    }
+
+    auto next = std::make_shared<Catalog>(std::move(message));
+
+    crow::json::wvalue response = crow::json::wvalue::list();
+    for (uint32_t i = 0; i < packages.size(); i++) {
+      response[i]["packageId"] = packages[i].getPackageId();
+      response[i]["packageName"] = std::string(packages[i].getPackageName().cStr());
+      response[i]["packageVersion"] = std::string(packages[i].getPackageVersion().cStr());
+    }
+    next->list.json = response.dump();
+    next->list.etag = HttpHeaders::strongETag(next->list.json);
+
+    // Keep JSON for packages whose version is unchanged; send requests for
+    // the rest together and wait for them as a batch.
+    std::map<uint32_t, std::future<std::string>> pending;
+    for (auto package : packages) {
+      uint32_t packageId = package.getPackageId();
+      if (previous) {
+        auto before = previous->message.get().getAvailablePackages();
+        auto old = std::find_if(before.begin(), before.end(), [&](PackageDetails::Reader p) {
+          return p.getPackageId() == packageId && p.getPackageVersion() == package.getPackageVersion();
+        });
+        auto cached = previous->json.find(packageId);
+        if (old != before.end() && cached != previous->json.end()) {
+          next->json.emplace(packageId, cached->second);
+          continue;
+        }
+      }
+      pending.emplace(packageId, engineService.GetPackageJsonAsync(packageId));
+    }
+    for (auto& [packageId, future] : pending) {
+      auto document = std::make_shared<Document>();
+      try {
+        document->json = future.get();
+      } catch (const std::exception& e) {
+        CROW_LOG_WARNING << "Package " << packageId << " JSON not cached: " << e.what();
+        continue;
+      }
+      document->etag = HttpHeaders::strongETag(document->json, HttpHeaders::hash(std::to_string(packageId)));
+      next->json.emplace(packageId, std::move(document));
+    }
+    return next;
+  }
+
+  static bool samePackages(capnp::List<PackageDetails, capnp::Kind::STRUCT>::Reader a,
+                           capnp::List<PackageDetails, capnp::Kind::STRUCT>::Reader b) {
+    if (a.size() != b.size()) {
+      return false;
+    }
+    for (uint32_t i = 0; i < a.size(); i++) {
+      if (a[i].getPackageId() != b[i].getPackageId() || a[i].getPackageVersion() != b[i].getPackageVersion() ||
+          a[i].getPackageName() != b[i].getPackageName()) {
+        return false;
+      }
+    }
+    return true;
+  }
+};
+
+#endif //PACKAGE_CATALOG_HPP_
@@ -6,14 +6,19 @@
 #define PACKAGE_ROUTES_HPP_
 
 #include "crow.h"
+#include "rest_app.hpp"
+#include "capnp_body.hpp"
 #include "engine_service.hpp"
+#include "http_headers.hpp"
 #include "open_api_builder.hpp"
+#include "package_catalog.hpp"
 
 class PackageRoutes {
  public:
-  static void registerRoutes(crow::App<crow::CORSHandler>& app, EngineService& engineService, OpenAPIBuilder& apiBuilder) {
+  static void registerRoutes(RestApp& app, EngineService& engineService, PackageCatalog& catalog,
+                             OpenAPIBuilder& apiBuilder) {
     setupSwaggerDocs(apiBuilder);
-    setupRoutes(app, engineService);
+    setupRoutes(app, engineService, catalog);
   }
 
  private:
@@ -71,27 +76,15 @@ class PackageRoutes {
     );
   }
 
-  static void setupRoutes(crow::App<crow::CORSHandler>& app, EngineService& engineService) {
+  static void setupRoutes(RestApp& app, EngineService& engineService, PackageCatalog& catalog) {
     CROW_ROUTE(app, "/api/packages")
         .methods("GET"_method)
-            ([&engineService]() {
+            ([&catalog](const crow::request& req) {
               try {
-                capnp::EzRpcClient client(kj::str("unix:", "/tmp/engine-socket").cStr());
-                Engine::Client engine = client.getMain<Engine>();
-
-                auto request = engine.getAvailablePackagesRequest();
-                auto response1 = request.send().wait(client.getWaitScope());
-
-                auto packages = response1.getAvailablePackages();
-
-                crow::json::wvalue response;
-                for (size_t i = 0; i < packages.size(); i++) {
-                  response[i]["packageId"] = packages[i].getPackageId();
-                  response[i]["packageName"] = packages[i].getPackageName().cStr();
-                  response[i]["packageVersion"] = packages[i].getPackageVersion().cStr();
-                }
-
-                return crow::response(response);
+                auto packages = catalog.get();
+                return documentResponse(req, packages->list, [&]() {
+                  return CapnpBody::respond(packages->message);
+                });
               } catch (const std::exception& e) {
                 return crow::response(500, e.what());
               }
@@ -99,16 +92,53 @@ class PackageRoutes {
 
     CROW_ROUTE(app, "/api/packages/<uint>/json")
         .methods("GET"_method)
-            ([&engineService](uint32_t packageId) {
+            ([&engineService, &catalog](const crow::request& req, uint32_t packageId) {
               try {
+                auto document = catalog.json(packageId);
+                if (document) {
+                  return documentResponse(req, *document, [&]() { return packageJsonCapnp(document->json); });
+                }
                 std::string jsonData = engineService.GetPackageJson(packageId);
-                return crow::response(jsonData);
+                if (CapnpBody::accepted(req)) {
+                  return packageJsonCapnp(jsonData);
+                }
+                crow::response res(jsonData);
+                res.add_header("Vary", "Accept");
+                return res;
               } catch (const std::exception& e) {
                 return crow::response(500, e.what());
               }
             });
+  }
 
+  static crow::response packageJsonCapnp(const std::string& jsonData) {
+    return CapnpBody::build<Engine::GetPackageJsonResults>([&](Engine::GetPackageJsonResults::Builder results) {
+      results.setJsonData(jsonData);
+    });
+  }
 
+  // A cached document as JSON, or as the Cap'n Proto message capnp() builds
+  // when the client prefers it. Each form has its own ETag, and a 304
+  // answers with the one that matched.
+  template <typename Func>
+  static crow::response documentResponse(const crow::request& req, const PackageCatalog::Document& document,
+                                         Func&& capnp) {
+    bool binary = CapnpBody::accepted(req);
+    auto etag = binary ? CapnpBody::etag(document.etag) : document.etag;
+    crow::response res;
+    if (HttpHeaders::noneMatch(req.get_header_value("If-None-Match"), etag)) {
+      res.code = 304;
+      res.add_header("Vary", "Accept");
+    } else if (binary) {
+      res = capnp();
+    } else {
+      res.body = document.json;
+      res.set_header("Content-Type", "application/json");
+      res.add_header("Vary", "Accept");
+    }
+    res.set_header("ETag", etag);
+    res.set_header("Cache-Control", "no-cache");
+    return res;
   }
 };
 
@@ -0,0 +1,122 @@
+//
+// Created by craig on 17/10/2026.
+//
+
+#ifndef POSITION_COALESCER_HPP_
+#define POSITION_COALESCER_HPP_
+
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include "crow.h"
+#include "engine_service.hpp"
+#include "node_snapshot_cache.hpp"
+
+// Buffers PUT /api/nodes position updates so a node being dragged does not
+// turn into one synchronous updateNode call per mouse event. Only the latest
+// position per instance is kept; a background thread sends what is pending
+// as one pipelined batch at most once per interval.
+class PositionCoalescer {
+ public:
+  PositionCoalescer(EngineService& engineService, NodeSnapshotCache& snapshots, std::chrono::milliseconds interval)
+      : engineService(engineService), snapshots(snapshots), interval(interval) {
+    flusher = std::thread([this]() { run(); });
+  }
+
+  ~PositionCoalescer() {
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      stopping = true;
+    }
+    wake.notify_all();
+    flusher.join();
+  }
+
+  PositionCoalescer(const PositionCoalescer&) = delete;
+  PositionCoalescer& operator=(const PositionCoalescer&) = delete;
+
+  void submit(uint32_t instanceId, int32_t posX, int32_t posY) {
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      pending[instanceId] = {posX, posY};
+    }
+    wake.notify_all();
+  }
+
+  // Forgets any position queued for instanceId and waits out a flush already
+  // in flight, so a write that follows (removing the node) reaches the engine
+  // after every position sent before it and is not followed by a stale one.
+  void drop(uint32_t instanceId) {
+    std::unique_lock<std::mutex> lock(mutex);
+    pending.erase(instanceId);
+    flushed.wait(lock, [this]() { return !flushing; });
+  }
+
+ private:
+  struct Position {
+    int32_t x;
+    int32_t y;
+  };
+
+  EngineService& engineService;
+  NodeSnapshotCache& snapshots;
+  const std::chrono::milliseconds interval;
+
+  std::mutex mutex;
+  std::condition_variable wake;
+  std::condition_variable flushed;
+  bool stopping = false;
+  bool flushing = false;
+  std::unordered_map<uint32_t, Position> pending;
+  std::thread flusher;
+
+  void run() {
+    std::unique_lock<std::mutex> lock(mutex);
+    while (true) {
+      wake.wait(lock, [this]() { return stopping || !pending.empty(); });
+      if (pending.empty()) {
+        return;  // stopping with nothing left to send
+      }
+
+      std::unordered_map<uint32_t, Position> batch;
+      batch.swap(pending);
+      flushing = true;
+      lock.unlock();
+      flush(batch);
+      lock.lock();
+      flushing = false;
+      flushed.notify_all();
+
+      wake.wait_for(lock, interval, [this]() { return stopping; });
+    }
+  }
+
+  void flush(const std::unordered_map<uint32_t, Position>& batch) {
+    std::vector<EngineService::GraphOp> ops;
+    ops.reserve(batch.size());
+    for (auto& [instanceId, position] : batch) {
+      EngineService::GraphOp op;
+      op.kind = EngineService::GraphOp::Kind::UPDATE_NODE;
+      op.node.instance_id = instanceId;
+      op.pos_x = position.x;
+      op.pos_y = position.y;
+      ops.push_back(std::move(op));
+    }
+
+    try {
+      auto result = engineService.ApplyGraphBatch(std::move(ops));
+      for (auto& op : result.results) {
+        if (!op.ok) {
+          CROW_LOG_WARNING << "Position update failed: " << op.error;
+        }
+      }
+      snapshots.invalidate();
+    } catch (const std::exception& e) {
+      CROW_LOG_WARNING << "Position flush failed: " << e.what();
+    }
+  }
+};
+
+#endif //POSITION_COALESCER_HPP_
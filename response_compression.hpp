@@ -0,0 +1,122 @@
+//
+// Created by craig on 17/10/2026.
+//
+
+#ifndef RESPONSE_COMPRESSION_HPP_
+#define RESPONSE_COMPRESSION_HPP_
+
+#include <string>
+#include <utility>
+#include <vector>
+#include "compression.hpp"
+#include "crow.h"
+#include "http_headers.hpp"
+
+// Compresses response bodies for clients that accept it. A body is
+// compressed when it is at least the threshold for its route: the longest
+// configured path prefix that matches, else the default. Bodies that are
+// already encoded (static assets) are left alone.
+//
+// A compressed body is a different representation, so its strong ETag gets
+// the coding as a suffix ("<hash>-gzip"). Clients revalidate with that tag;
+// it is mapped back to the route's own tag on the way in, and a 304 answers
+// with the tag the client sent.
+struct CompressionMiddleware {
+  struct context {
+    // (identity ETag, encoded ETag as sent) for each encoded tag in
+    // If-None-Match.
+    std::vector<std::pair<std::string, std::string>> encodedTags;
+  };
+
+  // Sets the default threshold in bytes.
+  void minBytes(size_t bytes) {
+    defaultMinBytes = bytes;
+  }
+
+  // Sets the threshold for URLs starting with prefix; SIZE_MAX disables
+  // compression there. Call before the app starts.
+  void minBytes(const std::string& prefix, size_t bytes) {
+    for (auto& route : routes) {
+      if (route.first == prefix) {
+        route.second = bytes;
+        return;
+      }
+    }
+    routes.emplace_back(prefix, bytes);
+  }
+
+  void before_handle(crow::request& req, crow::response&, context& ctx) {
+    auto ifNoneMatch = req.get_header_value("If-None-Match");
+    if (ifNoneMatch.empty()) {
+      return;
+    }
+    std::string rewritten;
+    HttpHeaders::forEachElement(ifNoneMatch, [&](std::string_view tag, std::string_view) {
+      auto identity = Compression::identityETag(tag);
+      if (!identity.empty()) {
+        ctx.encodedTags.emplace_back(identity, std::string(tag));
+      }
+      rewritten += rewritten.empty() ? "" : ", ";
+      rewritten += identity.empty() ? std::string(tag) : identity;
+    });
+    if (!ctx.encodedTags.empty()) {
+      req.headers.erase("If-None-Match");
+      req.headers.emplace("If-None-Match", rewritten);
+    }
+  }
+
+  void after_handle(crow::request& req, crow::response& res, context& ctx) {
+    if (res.code == 304) {
+      auto etag = res.get_header_value("ETag");
+      for (auto& [identity, encoded] : ctx.encodedTags) {
+        if (identity == etag) {
+          res.set_header("ETag", encoded);
+          break;
+        }
+      }
+      return;
+    }
+    if (res.code < 200 || res.code == 204 || res.body.size() < threshold(req.url) ||
+        !res.get_header_value("Content-Encoding").empty()) {
+      return;
+    }
+    // Large enough to compress, so the body depends on Accept-Encoding
+    // whether or not this client gets it compressed.
+    res.add_header("Vary", "Accept-Encoding");
+    auto encoding = Compression::negotiate(req.get_header_value("Accept-Encoding"));
+    if (encoding == Compression::Encoding::IDENTITY) {
+      return;
+    }
+
+    // Swapped with the body below, so the next response on this thread
+    // reuses the old body's capacity.
+    thread_local std::string buffer;
+    if (!Compression::compress(encoding, res.body, buffer) || buffer.size() >= res.body.size()) {
+      return;
+    }
+    res.body.swap(buffer);
+    res.set_header("Content-Encoding", Compression::encodingName(encoding));
+    auto etag = res.get_header_value("ETag");
+    if (!etag.empty()) {
+      res.set_header("ETag", Compression::encodedETag(etag, encoding));
+    }
+  }
+
+ private:
+  size_t defaultMinBytes = 1024;
+  std::vector<std::pair<std::string, size_t>> routes;
+
+  size_t threshold(const std::string& url) const {
+    size_t best = 0;
+    size_t bytes = defaultMinBytes;
+    for (auto& [prefix, minBytes] : routes) {
+      if (prefix.size() >= best && url.compare(0, prefix.size(), prefix) == 0) {
+        best = prefix.size();
+        bytes = minBytes;
+      }
+    }
+    return bytes;
+  }
+};
+
+#endif //RESPONSE_COMPRESSION_HPP_
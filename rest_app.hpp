@@ -0,0 +1,17 @@
+//
+// Created by craig on 17/10/2026.
+//
+
+#ifndef REST_APP_HPP_
+#define REST_APP_HPP_
+
+#include "crow.h"
+#include <crow/middlewares/cors.h>
+#include "metrics.hpp"
+#include "response_compression.hpp"
+
+// The Crow app every route registers on. after_handle runs in reverse order,
+// so responses are compressed before MetricsMiddleware records their size.
+using RestApp = crow::App<crow::CORSHandler, MetricsMiddleware, CompressionMiddleware>;
+
+#endif //REST_APP_HPP_
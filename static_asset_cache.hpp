@@ -0,0 +1,313 @@
+//
+// Created by craig on 17/10/2026.
+//
+
+#ifndef STATIC_ASSET_CACHE_HPP_
+#define STATIC_ASSET_CACHE_HPP_
+
+#include <poll.h>
+#include <sys/inotify.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <atomic>
+#include <ctime>
+#include <fstream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "compression.hpp"
+#include "crow.h"
+#include "http_headers.hpp"
+
+// Debug pages and the Swagger UI, held in memory with gzip and brotli
+// variants. Files are read once and reloaded when inotify reports them
+// written or replaced. Responses carry ETag and Last-Modified and must be
+// revalidated, so a browser refresh costs a 304.
+class StaticAssetCache {
+ public:
+  StaticAssetCache() {
+    inotifyFd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (inotifyFd < 0) {
+      CROW_LOG_WARNING << "inotify unavailable; static assets will not reload";
+    }
+  }
+
+  ~StaticAssetCache() {
+    stopping = true;
+    if (watcher.joinable()) {
+      watcher.join();
+    }
+    if (inotifyFd >= 0) {
+      close(inotifyFd);
+    }
+  }
+
+  StaticAssetCache(const StaticAssetCache&) = delete;
+  StaticAssetCache& operator=(const StaticAssetCache&) = delete;
+
+  // Serves `path` under `name`, reloading it whenever it changes on disk.
+  // A missing file answers 404 with notFound until it appears.
+  void addFile(const std::string& name, const std::string& path, const std::string& contentType,
+               const std::string& notFound = "File not found") {
+    auto& entry = entries[name];
+    entry.path = path;
+    entry.contentType = contentType;
+    entry.notFound = notFound;
+    entry.asset = load(entry);
+    watch(path);
+  }
+
+  // Serves fixed content under `name`.
+  void addContent(const std::string& name, const std::string& content, const std::string& contentType) {
+    auto& entry = entries[name];
+    entry.contentType = contentType;
+    entry.asset = build(content, contentType, time(nullptr));
+  }
+
+  crow::response serve(const crow::request& req, const std::string& name) {
+    auto found = entries.find(name);
+    if (found == entries.end()) {
+      return crow::response(404);
+    }
+    std::shared_ptr<const Asset> asset;
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      asset = found->second.asset;
+    }
+    if (!asset) {
+      return crow::response(404, found->second.notFound);
+    }
+
+    // One representation per encoding, each with its own strong ETag.
+    auto& identityTag = asset->etag;
+    auto ifNoneMatch = req.get_header_value("If-None-Match");
+    if (ifNoneMatch.empty() && req.get_header_value("If-Modified-Since") == asset->lastModified) {
+      crow::response res(304);
+      setCacheHeaders(res, *asset, identityTag);
+      return res;
+    }
+    if (!ifNoneMatch.empty()) {
+      for (auto encoding : {Compression::Encoding::IDENTITY, Compression::Encoding::GZIP,
+                            Compression::Encoding::BROTLI}) {
+        auto etag = Compression::encodedETag(identityTag, encoding);
+        if (HttpHeaders::noneMatch(ifNoneMatch, etag)) {
+          crow::response res(304);
+          setCacheHeaders(res, *asset, etag);
+          return res;
+        }
+      }
+    }
+
+    auto encoding = chooseEncoding(req.get_header_value("Accept-Encoding"), *asset);
+    crow::response res;
+    if (encoding == Compression::Encoding::BROTLI) {
+      res.body = asset->brotli;
+    } else if (encoding == Compression::Encoding::GZIP) {
+      res.body = asset->gzip;
+    } else {
+      res.body = asset->identity;
+    }
+    if (encoding != Compression::Encoding::IDENTITY) {
+      res.set_header("Content-Encoding", Compression::encodingName(encoding));
+    }
+    setCacheHeaders(res, *asset, Compression::encodedETag(identityTag, encoding));
+    res.set_header("Content-Type", asset->contentType);
+    return res;
+  }
+
+  // Starts the inotify thread; call once every asset has been added.
+  void start() {
+    if (inotifyFd >= 0 && !watches.empty()) {
+      watcher = std::thread([this]() { run(); });
+    }
+  }
+
+ private:
+  struct Asset {
+    std::string identity;
+    std::string gzip;
+    std::string brotli;
+    std::string contentType;
+    std::string etag;  // of the identity encoding; see Compression::encodedETag
+    std::string lastModified;
+  };
+
+  struct Entry {
+    std::string path;  // empty for fixed content
+    std::string contentType;
+    std::string notFound;
+    std::shared_ptr<const Asset> asset;
+  };
+
+  std::map<std::string, Entry> entries;  // fixed after start()
+  std::map<int, std::string> watches;    // inotify wd -> directory
+  std::vector<std::string> missing;      // asset directories not created yet
+  std::mutex mutex;                      // guards Entry::asset
+  int inotifyFd = -1;
+  std::atomic<bool> stopping{false};
+  std::thread watcher;
+
+  static void setCacheHeaders(crow::response& res, const Asset& asset, const std::string& etag) {
+    res.set_header("ETag", etag);
+    res.set_header("Last-Modified", asset.lastModified);
+    res.set_header("Cache-Control", "no-cache");
+    res.set_header("Vary", "Accept-Encoding");
+  }
+
+  // The encoding to send: of those held for the asset, the one the client
+  // weights highest, brotli on a tie. "*" stands for codings not named, and
+  // q=0 refuses a coding.
+  static Compression::Encoding chooseEncoding(const std::string& acceptEncoding, const Asset& asset) {
+    int brotli = -1;
+    int gzip = -1;
+    int any = -1;
+    HttpHeaders::forEachElement(acceptEncoding, [&](std::string_view coding, std::string_view params) {
+      int weight = HttpHeaders::quality(params);
+      if (coding == "br") {
+        brotli = weight;
+      } else if (coding == "gzip" || coding == "x-gzip") {
+        gzip = weight;
+      } else if (coding == "*") {
+        any = weight;
+      }
+    });
+    brotli = asset.brotli.empty() ? 0 : brotli < 0 ? any : brotli;
+    gzip = asset.gzip.empty() ? 0 : gzip < 0 ? any : gzip;
+    if (brotli > 0 && brotli >= gzip) {
+      return Compression::Encoding::BROTLI;
+    }
+    return gzip > 0 ? Compression::Encoding::GZIP : Compression::Encoding::IDENTITY;
+  }
+
+  static std::shared_ptr<const Asset> build(const std::string& content, const std::string& contentType, time_t mtime) {
+    auto asset = std::make_shared<Asset>();
+    asset->identity = content;
+    asset->gzip = Compression::gzip(content);
+    asset->brotli = Compression::brotli(content);
+    asset->contentType = contentType;
+
+    asset->etag = HttpHeaders::strongETag(content);
+
+    char buf[64];
+    tm gmt{};
+    gmtime_r(&mtime, &gmt);
+    strftime(buf, sizeof(buf), "%a, %d %b %Y %H:%M:%S GMT", &gmt);
+    asset->lastModified = buf;
+    return asset;
+  }
+
+  static std::shared_ptr<const Asset> load(const Entry& entry) {
+    std::ifstream file(entry.path, std::ios::binary);
+    struct stat info{};
+    if (!file.is_open() || stat(entry.path.c_str(), &info) != 0) {
+      return nullptr;
+    }
+    std::string content((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    return build(content, entry.contentType, info.st_mtime);
+  }
+
+  // Watches the file's directory, since editors usually replace files
+  // rather than write them in place. A directory that does not exist yet is
+  // waited for from its nearest existing ancestor.
+  void watch(const std::string& path) {
+    if (inotifyFd < 0) {
+      return;
+    }
+    auto dir = parentOf(path);
+    if (!watchDirectory(dir)) {
+      missing.push_back(dir);
+      watchAncestor(dir);
+    }
+  }
+
+  static std::string parentOf(const std::string& path) {
+    auto slash = path.rfind('/');
+    if (slash == std::string::npos) {
+      return ".";
+    }
+    return slash == 0 ? "/" : path.substr(0, slash);
+  }
+
+  // Whether dir is watched, adding the watch if it can.
+  bool watchDirectory(const std::string& dir) {
+    for (auto& [wd, watched] : watches) {
+      if (watched == dir) {
+        return true;
+      }
+    }
+    int wd = inotify_add_watch(inotifyFd, dir.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE | IN_DELETE);
+    if (wd < 0) {
+      return false;
+    }
+    watches[wd] = dir;
+    return true;
+  }
+
+  void watchAncestor(const std::string& dir) {
+    std::string child = dir;
+    for (auto ancestor = parentOf(child); ancestor != child; ancestor = parentOf(child)) {
+      if (watchDirectory(ancestor)) {
+        return;
+      }
+      child = ancestor;
+    }
+    CROW_LOG_WARNING << "Cannot watch " << dir << " for asset changes";
+  }
+
+  // After a directory appears, watches whichever missing directories now
+  // exist and loads the files already in them.
+  void watchMissing() {
+    for (auto it = missing.begin(); it != missing.end();) {
+      if (!watchDirectory(*it)) {
+        watchAncestor(*it);
+        ++it;
+        continue;
+      }
+      for (auto& [name, entry] : entries) {
+        if (parentOf(entry.path) == *it) {
+          reload(entry.path);
+        }
+      }
+      it = missing.erase(it);
+    }
+  }
+
+  void run() {
+    alignas(inotify_event) char buf[4096];
+    while (!stopping) {
+      pollfd pfd{inotifyFd, POLLIN, 0};
+      if (poll(&pfd, 1, 500) <= 0) {
+        continue;
+      }
+      ssize_t len;
+      while ((len = read(inotifyFd, buf, sizeof(buf))) > 0) {
+        for (char* p = buf; p < buf + len;) {
+          auto* event = reinterpret_cast<inotify_event*>(p);
+          p += sizeof(inotify_event) + event->len;
+          auto dir = watches.find(event->wd);
+          if (dir != watches.end() && event->len > 0) {
+            reload(dir->second + "/" + event->name);
+          }
+          if ((event->mask & IN_ISDIR) && !missing.empty()) {
+            watchMissing();
+          }
+        }
+      }
+    }
+  }
+
+  void reload(const std::string& path) {
+    for (auto& [name, entry] : entries) {
+      if (entry.path != path) {
+        continue;
+      }
+      auto asset = load(entry);
+      std::lock_guard<std::mutex> lock(mutex);
+      entry.asset = std::move(asset);
+    }
+  }
+};
+
+#endif //STATIC_ASSET_CACHE_HPP_
@@ -0,0 +1,61 @@
+//
+// Created by craig on 17/10/2026.
+//
+
+#ifndef STREAM_ROUTES_HPP_
+#define STREAM_ROUTES_HPP_
+
+#include "crow.h"
+#include "rest_app.hpp"
+#include "open_api_builder.hpp"
+#include "value_stream.hpp"
+
+class StreamRoutes {
+ public:
+  static void registerRoutes(RestApp& app, ValueStream& valueStream, OpenAPIBuilder& apiBuilder) {
+    setupSwaggerDocs(apiBuilder);
+    setupRoutes(app, valueStream);
+  }
+
+ private:
+  static void setupSwaggerDocs(OpenAPIBuilder& apiBuilder) {
+    apiBuilder.addEndpoint(
+        "/api/ws/values",
+        "GET",
+        "WebSocket stream of changed node values. The first frame holds every node; "
+        "later frames hold only changed IOs (or the whole node when its IOs changed) and removed "
+        "instance IDs. At most 4 frames are sent unacknowledged: send any message to acknowledge "
+        "each frame, or no more are sent. A client that falls behind gets one catch-up frame "
+        "instead of a queue.",
+        crow::json::wvalue(),  // no request body
+        {{"101", {{"description", "Switching to WebSocket; an unknown format closes the connection"}}}},
+        {OpenAPIBuilder::createParameter(
+            "format",
+            "query",
+            false,
+            "string",
+            "Frame encoding: json (text frames, the default), cbor or msgpack (binary frames)"
+        )}
+    );
+  }
+
+  static void setupRoutes(RestApp& app, ValueStream& valueStream) {
+    CROW_WEBSOCKET_ROUTE(app, "/api/ws/values")
+        .onaccept([](const crow::request& req, void** userdata) {
+          auto format = ValueStream::formatFor(req.url_params.get("format"));
+          *userdata = const_cast<ValueStream::Format*>(format);
+          return format != nullptr;
+        })
+        .onopen([&valueStream](crow::websocket::connection& conn) {
+          valueStream.open(conn, *static_cast<const ValueStream::Format*>(conn.userdata()));
+        })
+        .onclose([&valueStream](crow::websocket::connection& conn, const std::string&) {
+          valueStream.close(conn);
+        })
+        .onmessage([&valueStream](crow::websocket::connection& conn, const std::string&, bool) {
+          valueStream.ack(conn);
+        });
+  }
+};
+
+#endif //STREAM_ROUTES_HPP_
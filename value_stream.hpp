@@ -0,0 +1,339 @@
+//
+// Created by craig on 17/10/2026.
+//
+
+#ifndef VALUE_STREAM_HPP_
+#define VALUE_STREAM_HPP_
+
+#include <condition_variable>
+#include <cstring>
+#include <map>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include "crow.h"
+#include "node_binary_writer.hpp"
+#include "node_snapshot_cache.hpp"
+#include "node_values.hpp"
+
+// Pushes changed node values to WebSocket clients. One thread polls the
+// shared snapshot cache, however many clients are connected, and each frame
+// carries only the IOs that differ from the snapshot that client last got.
+// Frames are JSON text, or CBOR/MessagePack binary for clients that connect
+// with ?format=cbor or ?format=msgpack.
+//
+// Every client is flow controlled, since Crow queues sends without limit
+// and does not expose a connection's backlog: a client may have at most
+// `window` frames unacknowledged, and acknowledges one by sending any
+// message (a client that only listens stops getting frames once its window
+// is full). A client at its window is skipped, and when it catches up its
+// next frame covers everything it missed, so a slow consumer costs one
+// snapshot reference rather than a growing queue.
+class ValueStream {
+ public:
+  enum class Format {
+    JSON,
+    CBOR,
+    MSGPACK,
+  };
+
+  ValueStream(NodeSnapshotCache& snapshots, std::chrono::milliseconds interval, uint32_t window = 4)
+      : snapshots(snapshots), interval(interval), window(window) {
+    poller = std::thread([this]() { run(); });
+  }
+
+  ~ValueStream() {
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      stopping = true;
+    }
+    wake.notify_all();
+    poller.join();
+  }
+
+  ValueStream(const ValueStream&) = delete;
+  ValueStream& operator=(const ValueStream&) = delete;
+
+  void open(crow::websocket::connection& conn, Format format = Format::JSON) {
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      clients[&conn] = Client{nullptr, 0, format};
+    }
+    wake.notify_all();
+  }
+
+  void close(crow::websocket::connection& conn) {
+    std::lock_guard<std::mutex> lock(mutex);
+    clients.erase(&conn);
+  }
+
+  void ack(crow::websocket::connection& conn) {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = clients.find(&conn);
+    if (it != clients.end() && it->second.unacked > 0) {
+      it->second.unacked--;
+    }
+  }
+
+  // The frame format for a ?format= value (json, cbor or msgpack; JSON when
+  // absent), or null if it is unknown. Points at a static, so it can be kept
+  // as a connection's userdata.
+  static const Format* formatFor(const char* name) {
+    static const Format formats[] = {Format::JSON, Format::CBOR, Format::MSGPACK};
+    if (name == nullptr || strcmp(name, "json") == 0) return &formats[0];
+    if (strcmp(name, "cbor") == 0) return &formats[1];
+    if (strcmp(name, "msgpack") == 0) return &formats[2];
+    return nullptr;
+  }
+
+  // Changes from `previous` to `current` as
+  // {"nodes":[{instanceId, nodeStatus?, inputs, outputs}], "removed":[ids]},
+  // in JSON or with the same keys in CBOR/MessagePack. With no previous
+  // snapshot every node and IO is included; a node whose IO names changed is
+  // sent whole, so clients replace it. Returns an empty string when
+  // nothing changed.
+  static std::string diffFrame(const NodeSnapshotCache::Snapshot* previous,
+                               const NodeSnapshotCache::Snapshot& current, Format format = Format::JSON) {
+    auto changes = diff(previous, current);
+    if (changes.nodes.empty() && changes.removed.empty()) {
+      return std::string();
+    }
+    auto nodes = current.message.get().getNodes();
+    return format == Format::JSON ? writeJson(changes, nodes)
+                                  : writeBinary(changes, nodes, format == Format::CBOR ? NodeBinaryWriter::Format::CBOR
+                                                                                       : NodeBinaryWriter::Format::MSGPACK);
+  }
+
+ private:
+  // A node in a frame: sent whole when it is new or its IO names changed
+  // (so clients drop IOs it no longer has), otherwise as its changed status
+  // and IOs (positions in its input and output lists).
+  struct NodeChange {
+    uint32_t index;
+    bool whole;
+    bool statusChanged;
+    std::vector<uint32_t> inputs;
+    std::vector<uint32_t> outputs;
+  };
+
+  struct Diff {
+    std::vector<NodeChange> nodes;
+    std::vector<uint32_t> removed;
+  };
+
+  static Diff diff(const NodeSnapshotCache::Snapshot* previous, const NodeSnapshotCache::Snapshot& current) {
+    std::unordered_map<uint32_t, Node::Reader> before;
+    if (previous != nullptr) {
+      auto nodes = previous->message.get().getNodes();
+      before.reserve(nodes.size());
+      for (auto node : nodes) {
+        before.emplace(node.getInstanceId(), node);
+      }
+    }
+
+    Diff changes;
+    auto nodes = current.message.get().getNodes();
+    for (uint32_t i = 0; i < nodes.size(); i++) {
+      auto node = nodes[i];
+      auto found = before.find(node.getInstanceId());
+      if (found == before.end()) {
+        changes.nodes.push_back(NodeChange{i, true, false, {}, {}});
+        continue;
+      }
+      auto old = found->second;
+      before.erase(found);
+
+      if (!sameNames(old.getInputs(), node.getInputs()) || !sameNames(old.getOutputs(), node.getOutputs())) {
+        changes.nodes.push_back(NodeChange{i, true, false, {}, {}});
+        continue;
+      }
+      bool statusChanged = !NodeValues::sameStatus(old.getNodeStatus(), node.getNodeStatus());
+      auto inputs = changedIOs(old.getInputs(), node.getInputs());
+      auto outputs = changedIOs(old.getOutputs(), node.getOutputs());
+      if (statusChanged || !inputs.empty() || !outputs.empty()) {
+        changes.nodes.push_back(NodeChange{i, false, statusChanged, std::move(inputs), std::move(outputs)});
+      }
+    }
+    for (auto& [instanceId, node] : before) {
+      changes.removed.push_back(instanceId);
+    }
+    return changes;
+  }
+
+  static std::string writeJson(const Diff& changes, capnp::List<Node, capnp::Kind::STRUCT>::Reader nodes) {
+    std::string out;
+    NodeJsonWriter writer(out);
+    out += "{\"nodes\":[";
+    for (size_t i = 0; i < changes.nodes.size(); i++) {
+      auto& change = changes.nodes[i];
+      auto node = nodes[change.index];
+      if (i > 0) {
+        out.push_back(',');
+      }
+      if (change.whole) {
+        writer.writeNode(node);
+        continue;
+      }
+      out += "{\"instanceId\":";
+      writer.writeUint(node.getInstanceId());
+      if (change.statusChanged) {
+        out += ",\"nodeStatus\":";
+        writer.writeNodeStatus(node.getNodeStatus());
+      }
+      out += ",\"inputs\":[";
+      writeIOs(writer, node.getInputs(), change.inputs, "\"default_value\":");
+      out += "],\"outputs\":[";
+      writeIOs(writer, node.getOutputs(), change.outputs, "\"fallback_value\":");
+      out += "]}";
+    }
+
+    out += "],\"removed\":[";
+    for (size_t i = 0; i < changes.removed.size(); i++) {
+      if (i > 0) {
+        out.push_back(',');
+      }
+      writer.writeUint(changes.removed[i]);
+    }
+    out += "]}";
+    return out;
+  }
+
+  static std::string writeBinary(const Diff& changes, capnp::List<Node, capnp::Kind::STRUCT>::Reader nodes,
+                                 NodeBinaryWriter::Format format) {
+    std::string out;
+    NodeBinaryWriter writer(out, format);
+    writer.writeMap(2);
+    writer.writeKey("nodes");
+    writer.writeArray(changes.nodes.size());
+    for (auto& change : changes.nodes) {
+      auto node = nodes[change.index];
+      if (change.whole) {
+        writer.writeNode(node);
+        continue;
+      }
+      writer.writeMap(change.statusChanged ? 4 : 3);
+      writer.writeKey("instanceId");
+      writer.writeUint(node.getInstanceId());
+      if (change.statusChanged) {
+        writer.writeKey("nodeStatus");
+        writer.writeNodeStatus(node.getNodeStatus());
+      }
+      writer.writeKey("inputs");
+      writer.writeArray(change.inputs.size());
+      for (uint32_t i : change.inputs) {
+        writer.writeIO(node.getInputs()[i], "default_value");
+      }
+      writer.writeKey("outputs");
+      writer.writeArray(change.outputs.size());
+      for (uint32_t i : change.outputs) {
+        writer.writeIO(node.getOutputs()[i], "fallback_value");
+      }
+    }
+    writer.writeKey("removed");
+    writer.writeArray(changes.removed.size());
+    for (uint32_t instanceId : changes.removed) {
+      writer.writeUint(instanceId);
+    }
+    return out;
+  }
+
+  struct Client {
+    std::shared_ptr<const NodeSnapshotCache::Snapshot> lastSent;
+    uint32_t unacked = 0;
+    Format format = Format::JSON;
+  };
+
+  NodeSnapshotCache& snapshots;
+  const std::chrono::milliseconds interval;
+  const uint32_t window;
+
+  std::mutex mutex;
+  std::condition_variable wake;
+  bool stopping = false;
+  std::map<crow::websocket::connection*, Client> clients;
+  std::thread poller;
+
+  static bool sameNames(capnp::List<IO, capnp::Kind::STRUCT>::Reader before,
+                        capnp::List<IO, capnp::Kind::STRUCT>::Reader after) {
+    if (before.size() != after.size()) {
+      return false;
+    }
+    for (uint32_t i = 0; i < after.size(); i++) {
+      if (before[i].getName() != after[i].getName()) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  // Positions whose IO differs; both lists have the same names (sameNames).
+  static std::vector<uint32_t> changedIOs(capnp::List<IO, capnp::Kind::STRUCT>::Reader before,
+                                          capnp::List<IO, capnp::Kind::STRUCT>::Reader after) {
+    std::vector<uint32_t> changed;
+    for (uint32_t i = 0; i < after.size(); i++) {
+      if (!NodeValues::sameIO(before[i], after[i])) {
+        changed.push_back(i);
+      }
+    }
+    return changed;
+  }
+
+  static void writeIOs(NodeJsonWriter& writer, capnp::List<IO, capnp::Kind::STRUCT>::Reader ios,
+                       const std::vector<uint32_t>& indexes, const char* defaultKey) {
+    for (size_t i = 0; i < indexes.size(); i++) {
+      if (i > 0) {
+        writer.writeRaw(",");
+      }
+      writer.writeIO(ios[indexes[i]], defaultKey);
+    }
+  }
+
+  void run() {
+    std::unique_lock<std::mutex> lock(mutex);
+    while (!stopping) {
+      wake.wait_for(lock, interval);
+      if (stopping || clients.empty()) {
+        continue;
+      }
+
+      lock.unlock();
+      std::shared_ptr<const NodeSnapshotCache::Snapshot> snapshot;
+      try {
+        snapshot = snapshots.get();
+      } catch (const std::exception& e) {
+        CROW_LOG_WARNING << "Value stream poll failed: " << e.what();
+      }
+      lock.lock();
+      if (snapshot) {
+        publish(snapshot);
+      }
+    }
+  }
+
+  // Called with the mutex held. Clients that were sent the same snapshot in
+  // the same format share one diff.
+  void publish(const std::shared_ptr<const NodeSnapshotCache::Snapshot>& snapshot) {
+    std::map<std::pair<const NodeSnapshotCache::Snapshot*, Format>, std::string> frames;
+    for (auto& [conn, client] : clients) {
+      if (client.lastSent == snapshot || client.unacked >= window) {
+        continue;
+      }
+      auto key = std::make_pair(client.lastSent.get(), client.format);
+      auto frame = frames.find(key);
+      if (frame == frames.end()) {
+        frame = frames.emplace(key, diffFrame(client.lastSent.get(), *snapshot, client.format)).first;
+      }
+      if (!frame->second.empty()) {
+        if (client.format == Format::JSON) {
+          conn->send_text(frame->second);
+        } else {
+          conn->send_binary(frame->second);
+        }
+        client.unacked++;
+      }
+      client.lastSent = snapshot;
+    }
+  }
+};
+
+#endif //VALUE_STREAM_HPP_